@@ -4,7 +4,7 @@ import ollama
 from typing import Dict, Any, List, Tuple
 import re
 import time
-from dataclasses import dataclass
+from dataclasses import dataclass, field
 
 @dataclass
 class CodeMetrics:
@@ -21,6 +21,10 @@ class CodeMetrics:
     potential_edge_cases: List[str]
     program_type: str
     difficulty_level: str
+    failed_test_diffs: List[Dict[str, Any]] = field(default_factory=list)
+    verdicts: Dict[str, int] = field(default_factory=dict)
+    compile_result: str = "ok"
+    compiler_diagnostics: List[Dict[str, Any]] = field(default_factory=list)
 
 class AdvancedCodeAnalyzer:
     def __init__(self, model_name="codellama:13b-instruct"):
@@ -220,7 +224,11 @@ Create a comprehensive learning-focused report in JSON:
             failed_tests=eval_results.get('failed_test_details', []),
             potential_edge_cases=eval_results.get('potential_edge_cases', []),
             program_type=eval_results.get('program_type', 'unknown'),
-            difficulty_level=eval_results.get('difficulty_level', 'unknown')
+            difficulty_level=eval_results.get('difficulty_level', 'unknown'),
+            failed_test_diffs=eval_results.get('failed_test_diffs', []),
+            verdicts=eval_results.get('verdicts', {}),
+            compile_result=eval_results.get('compile_result', 'ok'),
+            compiler_diagnostics=eval_results.get('compiler_diagnostics', [])
         )
 
     def analyze_code_structure(self, code: str) -> Dict[str, Any]:
@@ -327,6 +335,10 @@ EVALUATION CONTEXT:
 - Pass Rate: {metrics.passrate}% ({metrics.tests_passed}/{metrics.total_tests})
 - Memory Score: {metrics.memory_score}
 - Execution Time: {metrics.execution_time_ms}ms
+- Compile Result: {metrics.compile_result}
+
+COMPILER DIAGNOSTICS (gcc -Wall):
+{self.format_compiler_diagnostics(metrics.compiler_diagnostics)}
 
 C SOURCE CODE TO ANALYZE:
 ```c
@@ -352,6 +364,39 @@ Perform deep algorithmic and structural analysis following the JSON format speci
         
         return analysis
 
+    def format_compiler_diagnostics(self, diagnostics: List[Dict[str, Any]]) -> str:
+        """Render the evaluator's compiler diagnostics as file:line:col lines"""
+        if not diagnostics:
+            return "No compiler diagnostics."
+        lines = []
+        for diag in diagnostics:
+            location = diag.get('file', '')
+            if diag.get('line'):
+                location += f":{diag['line']}"
+                if diag.get('column'):
+                    location += f":{diag['column']}"
+            lines.append(f"{location}: {diag.get('severity', '')}: {diag.get('message', '')}")
+        return chr(10).join(lines)
+
+    def format_failed_diffs(self, diffs: List[Dict[str, Any]]) -> str:
+        """Render the evaluator's line diffs as compact unified-style hunks"""
+        if not diffs:
+            return "No line diffs available."
+
+        blocks = []
+        for diff in diffs:
+            header = f"Test {diff.get('test')} ({diff.get('description', '')}), expected output from {diff.get('expected_from', 'literal')}"
+            if not diff.get('actual_complete', True):
+                header += ", program stopped at first divergence"
+            lines = [header]
+            for hunk in diff.get('hunks', []):
+                lines.append(f"@@ expected line {hunk.get('expected_line')}, actual line {hunk.get('actual_line')} @@")
+                lines.extend(hunk.get('lines', []))
+            if diff.get('truncated'):
+                lines.append("... (diff truncated)")
+            blocks.append(chr(10).join(lines))
+        return (chr(10) * 2).join(blocks)
+
     def stage_2_failure_analysis(self, source_code: str, metrics: CodeMetrics, code_analysis: Dict[str, Any]) -> Dict[str, Any]:
         """Stage 2: Deep analysis of test failures"""
         print("🔍 Stage 2: Test Failure Analysis...")
@@ -377,6 +422,12 @@ PREVIOUS CODE ANALYSIS INSIGHTS:
 FAILED TEST DETAILS:
 {chr(10).join(metrics.failed_tests)}
 
+VERDICT COUNTS (WA wrong answer, TLE-CPU/TLE-wall time limit, MLE memory limit, RE crash or error exit, OLE output limit):
+{', '.join(f'{name}: {count}' for name, count in metrics.verdicts.items() if count) or 'none recorded'}
+
+OUTPUT DIFFS (first differing lines; '-' expected, '+' actual, ' ' context):
+{self.format_failed_diffs(metrics.failed_test_diffs)}
+
 PERFORMANCE METRICS:
 - Memory Score: {metrics.memory_score} (100 = no leaks, 0 = has leaks)
 - Robustness Score: {metrics.robustness_score} (how well handles edge cases)
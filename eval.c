@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // memfd_create
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,41 +11,154 @@
 #include <sys/stat.h>
 #include <sys/resource.h>
 #include <ctype.h>
+#include <stdint.h>
 #include <json-c/json.h> // For JSON parsing
 #include <sys/time.h>    // For gettimeofday
+#include <getopt.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <math.h>
+#include <ftw.h>
+#include <sys/sendfile.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
 
 // --- Configuration & Constants ---
-#define MAX_TESTS 20
+#define MAX_TESTS 100000 // Upper bound on suite size; the suite is allocated to fit
+#define MAX_FAILED_DETAILS 20
+#define MAX_EDGE_CASES 20
+#define MAX_GENERATORS 20
 #define TIMEOUT_SECONDS 5
 #define MAX_OUTPUT_SIZE 4096
 #define MEMORY_LIMIT_MB 64
+#define MLE_PEAK_MARGIN_MB 8 // A failure counts as MLE only with the peak this close to MEMORY_LIMIT_MB
 #define CPU_TIME_LIMIT_S 2
 #define MAX_INPUT_SIZE 1024
 #define MAX_EXPECTED_OUTPUT_SIZE 1024
 #define MAX_DESCRIPTION_SIZE 256
+#define MAX_PATH_SIZE 256
+#define MAX_CACHE_DIR_LENGTH (MAX_PATH_SIZE - 48) // Leaves room for the file names kept inside
+#define DEFAULT_GENERATOR_SIZE 1000
+#define DEFAULT_OUTPUT_LIMIT_BYTES (64L << 20)
+#define DEFAULT_OUTPUT_LIMIT_LINES 0 // 0 = no line limit
+#define MAX_COMPARE_TOKEN 128 // Longer tokens are still compared, but only byte for byte
+#define DEFAULT_ABS_EPSILON 1e-6
+#define DEFAULT_REL_EPSILON 1e-6
+#define COMPARE_BUFFER_SIZE (1 << 16)
+// Whitespace as isspace() in the C locale: ' ' and '\t' through '\r'
+#define IS_SPACE_BYTE(c) ((c) == ' ' || (unsigned char)((c) - '\t') <= '\r' - '\t')
+#define DIFF_MAX_LINES 1000        // Lines loaded per side, starting just before the first difference
+#define DIFF_MAX_BYTES (256 * 1024) // Line text kept per side
+#define DIFF_MAX_LINE_LENGTH 200   // Longer lines are cut in the report
+#define DIFF_MAX_EDITS 256         // Myers search depth before reporting the window as replaced
+#define DIFF_MAX_HUNKS 3
+#define DIFF_MAX_HUNK_LINES 40
+#define DIFF_CONTEXT_LINES 2
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define USER_COMPILER "gcc"    // Also part of the grade store key, with USER_LINK_FLAGS
+#define USER_LINK_FLAGS "-lm"
+#define USER_WARNING_FLAGS "-Wall" // Only adds diagnostics for the results; code generation is unchanged
+#define MAX_COMPILER_DIAGNOSTICS 64
+#define DIAGNOSTICS_PARSE_LIMIT (1 << 20) // Compiler output past this is echoed but not parsed
+#define MAX_COMMAND_ARGS 64
+#define COMPILE_WALL_LIMIT_MS 30000  // Per compiler invocation; the whole process group is killed after it
+#define COMPILE_CPU_LIMIT_S 20
+#define COMPILE_MEMORY_LIMIT_MB 1024
+#define COMPILE_OUTPUT_LIMIT_MB 256  // Largest file (.i, object, binary) the compiler may write
+#define COMMAND_STORAGE_SIZE 2048
+#define AUTO_PROFILE_SMALL_INPUT (64L * 1024)          // Auto profile: below this much test input, don't optimize
+#define AUTO_PROFILE_LARGE_INPUT (16L * 1024 * 1024)   // ... and from here on, build for speed
+#define GENERATED_BYTES_PER_UNIT 8 // Rough input bytes per generator size unit, for the auto profile
+#define MAX_COMPILE_VARIANTS 8
+#define SMOKE_COMPILER "tcc" // Preprocesses, compiles and links in one go
+#define DEFAULT_PCH_INCLUDES "stdio.h,stdlib.h,string.h,math.h"
+#define MAX_PCH_INCLUDES 16
+#define GRADE_STORE_VERSION 1 // Bump when verdict semantics change, so stored grades are not reused
+#define SHARED_SUITE_DIR "/dev/shm"
+#define SHARED_SUITE_MAGIC 0x45564c53u // "EVLS"
+#define IN_MEMORY_TEMP_DIR "/dev/shm" // --in-memory: compiler outputs go to tmpfs before moving into memfds
 
 #define RESULTS_JSON_PATH "/tmp/eval_results.json"
-#define VALGRIND_LOG_PATH "/tmp/valgrind_log.txt"
+#define VALGRIND_LOG_PATH "/tmp/valgrind_log.txt"  // Also holds the ASan report for the asan variant
+#define ASAN_ERROR_EXIT_CODE 23
 #define EXEC_FAILURE_EXIT_CODE 127
+#define EXEC_NO_MEMORY_EXIT_CODE 126 // execl failed with ENOMEM: the image alone exceeds the memory limit
+#define MEMORY_SAMPLE_INTERVAL_MS 10 // How often a running child's peak memory is read from /proc
+#define RUN_ABORTED -2 // Run status when the child was killed at its first wrong output byte
+#define RUN_OUTPUT_LIMIT -3 // Run status when the child was killed for printing too much
 #define ROBUSTNESS_SIGINT_WAIT_US 200000 // 200ms
+#define MAX_PENDING_CHECKS 4 // Checker processes allowed to run behind the test loop
+#define MAX_CHECKER_OUTPUT 512
+#define JUDGE_WRONG_OUTPUT 1 // judge_test: the output differs from the expected one
+#define JUDGE_OUTPUT_LIMIT 2 // judge_test, judge_interactive_test: killed for printing too much
+#define JUDGE_NEEDS_CHECKER 3 // judge_test: the run finished cleanly and awaits the checker
+#define JUDGE_DECIDED 4 // judge_interactive_test: the interactor's verdict is already recorded
+#define INTERACTION_BUFFER_SIZE (1 << 16) // Relay buffer per direction
 
 // --- Enhanced Structs ---
+// Why a test passed or failed; see verdict_names for the reported spellings
+typedef enum {
+    VERDICT_AC,       // Accepted
+    VERDICT_WA,       // Wrong answer
+    VERDICT_TLE_CPU,  // CPU time limit (RLIMIT_CPU) hit
+    VERDICT_TLE_WALL, // Wall clock timeout while not using the CPU
+    VERDICT_MLE,      // Memory limit (RLIMIT_AS) hit
+    VERDICT_RE,       // Crash or non-zero exit
+    VERDICT_OLE,      // Output limit exceeded
+    VERDICT_JE,       // Judge error: reference, checker or interactor failed
+    VERDICT_COUNT
+} Verdict;
+
+typedef enum {
+    COMPARE_EXACT,      // Byte for byte, trailing whitespace ignored
+    COMPARE_WHITESPACE, // Tokens and line breaks must match; spacing within a line is free
+    COMPARE_TOKEN,      // Whitespace-separated tokens must match, layout is free
+    COMPARE_NUMERIC     // As COMPARE_TOKEN, numbers equal within abs/rel epsilon
+} CompareMode;
+
+typedef struct {
+    CompareMode mode;
+    double abs_epsilon;
+    double rel_epsilon;
+} ComparatorSpec;
+
 typedef struct {
     char input[MAX_INPUT_SIZE];
     char expected_output[MAX_EXPECTED_OUTPUT_SIZE];
     char description[MAX_DESCRIPTION_SIZE];
     char category[32]; // normal, edge, error, corner
     float weight;      // Test importance weight
+    char generator[MAX_PATH_SIZE]; // Built-in generator name or generator .c path; empty for literal input
+    uint64_t seed;     // Generator seed
+    long gen_size;     // Generator size parameter
+    uint64_t expected_hash; // Normalized hash of expected_output, computed at load
+    long expected_length;   // Length of expected_output without trailing whitespace
+    ComparatorSpec comparator; // How output is judged; defaults to the suite's comparator
+    long output_limit_bytes;   // Kill the run past this many output bytes; 0 = unlimited
+    long output_limit_lines;   // Kill the run past this many output lines; 0 = unlimited
 } DynamicTestCase;
 
+// One flat allocation (no pointers) so a parsed suite can be published to shared memory as-is
 typedef struct {
-    DynamicTestCase tests[MAX_TESTS];
     int num_tests;
     char program_description[512];
     char program_type[64];
     char difficulty_level[32];
-    char potential_edge_cases[MAX_TESTS][256];
+    char potential_edge_cases[MAX_EDGE_CASES][256];
     int num_edge_cases;
+    char reference_source[MAX_PATH_SIZE]; // Reference solution producing expected output for generated tests
+    ComparatorSpec comparator;            // Suite-wide default comparator
+    char checker_source[MAX_PATH_SIZE];   // Checker program deciding verdicts; empty to use the comparator
+    char interactor_source[MAX_PATH_SIZE]; // Judge the program talks to instead of reading fixed input
+    char compile_variants[128];           // Extra builds of the program, comma-separated (e.g. "asan,gcov")
+    char compile_profile[32];             // Optimization profile name, or "auto"/empty to pick by input size
+    long output_limit_bytes;              // Suite-wide default output limits
+    long output_limit_lines;
+    DynamicTestCase tests[];              // num_tests entries
 } TestSuite;
 
 typedef struct {
@@ -55,29 +169,465 @@ typedef struct {
     long execution_time_ms;
     int tests_passed;
     int tests_failed;
-    char failed_tests[MAX_TESTS][512]; // Details of failed tests
+    char failed_tests[MAX_FAILED_DETAILS][512]; // Details of failed tests
     int num_failed_details;
+    char *failed_diffs[MAX_FAILED_DETAILS]; // Line diffs of wrong answers, as JSON objects
+    int num_failed_diffs;
+    int reused_results; // Tests answered from the run memo instead of executing
+    int stored_results; // Tests answered from the --regrade store without running
+    int output_limit_exceeded; // Tests killed for exceeding their output limit (OLE)
+    long interaction_queries;  // Interactive tests: lines sent to the interactor
+    long interaction_round_trips; // Interactor replies the program answered
+    double interaction_latency_ms; // Summed program response time over those round trips
+    double interaction_max_latency_ms;
+    int verdict_counts[VERDICT_COUNT];
+    int tests_run;      // Tests selected for this process (all unless sharded)
+    int quality_checks_skipped; // Memory/robustness left to another shard
+    const char *early_stop;     // "reached"/"unreachable" when --target-score settled early
+    float score_lower_bound;    // Weighted score range still possible when stopped early
+    float score_upper_bound;
 } EnhancedEvalMetrics;
 
+typedef struct {
+    int selected; // Runs in this process (see --shard / --tests)
+    int from_store;    // Outcome taken from the --regrade store; not run again
+    uint64_t grade_key; // grade_test_key(), with --regrade
+    int passed;
+    Verdict verdict;
+    float score;       // Credit in [0, 1]; only a checker gives partial credit
+    int output_limit_exceeded;
+    long output_bytes; // Bytes printed before an OLE kill
+    long queries;      // Interactive tests only, see TestRun
+    long round_trips;
+    double mean_latency_ms;
+    double max_latency_ms;
+} TestOutcome;
+
+typedef struct {
+    int test_id; // 1-based, as printed
+    int passed;
+    double score;  // Credit in [0, 1]; defaults to passed
+    double weight;
+    json_object *entry; // The partial's test_results entry, copied as-is
+    int partial;        // Index of the partial it came from; the earliest one wins
+} MergedTestResult;
+
+// One source in a batch; identical normalized sources share one evaluation
+typedef struct {
+    const char *source;
+    char *normalized;  // Source without comments or layout-only whitespace, see normalize_source
+    size_t length;
+    uint64_t hash;
+    int representative; // Index of the submission that is evaluated for this one (itself if first)
+} BatchSubmission;
+
+// A checker process still deciding a test while the loop moves on
+typedef struct {
+    pid_t pid;
+    int index;      // Test being checked
+    int output_fd;  // memfd holding the checker's stdout
+    long start_ms;
+} PendingCheck;
+
+typedef struct {
+    uint64_t key;  // Test identity (input/generator spec and limits), independent of suite order
+    int runs;
+    int failures;
+} TestHistory;
+
+// A test's sort key for --target-score scheduling, computed once before sorting
+typedef struct {
+    int index;
+    double weight;
+    double failure_rate;
+} ScheduledTest;
+
+// Named optimization level for building the program
+typedef struct {
+    const char *name;
+    const char *flags;
+} CompileProfile;
+
+// A known way to build the program besides the plain binary
+typedef struct {
+    const char *name;
+    const char *flags; // Added when compiling the preprocessed unit
+} CompileVariantSpec;
+
+// An argv for a child process, built without a shell so paths and inputs need no quoting
+typedef struct {
+    char *argv[MAX_COMMAND_ARGS + 1];
+    int argc;
+    char storage[COMMAND_STORAGE_SIZE]; // The argument strings
+    size_t used;
+    int compiler; // Own process group under the COMPILE_* limits, see run_compiler
+    int report_diagnostics; // Builds the submission: its diagnostics go into the results
+} Command;
+
+// One compiler message about the submission, as reported in the results
+typedef struct {
+    char file[MAX_PATH_SIZE];
+    int line;          // 0 when the tool gave none (driver, linker)
+    int column;
+    char severity[16]; // "error", "fatal error", "warning" or "note"
+    char message[256];
+} CompilerDiagnostic;
+
+// How a compiler invocation ended; anything but OK fails that build
+typedef enum {
+    COMPILE_OK,
+    COMPILE_ERROR,        // Diagnostics in the source (or anything not listed below)
+    COMPILE_TIMEOUT,      // Wall or CPU limit
+    COMPILE_OOM,          // Ran out of its address-space limit
+    COMPILE_OUTPUT_LIMIT, // Tried to write a file over COMPILE_OUTPUT_LIMIT_MB
+    COMPILE_RESULT_COUNT
+} CompileResult;
+
+// One build of the program in this run's compile manifest
+typedef struct {
+    const CompileVariantSpec *spec;
+    char path[MAX_PATH_SIZE];
+    pid_t pid;       // Compiler process while building
+    int ok;
+    int used_pch;    // Built from the source with the cached precompiled header forced in
+    int diagnostics_fd; // Compiler stderr while building, echoed once it exits
+    CompileResult result;
+    long compile_ms;
+} CompileVariant;
+
+// One test outcome in the --regrade store
+typedef struct {
+    uint64_t test_key; // grade_test_key(): everything that decides the outcome besides the binary
+    Verdict verdict;
+    int passed;
+    float score;
+    long output_bytes;
+    int superseded; // Re-graded in this run; not written back twice
+} StoredGrade;
+
+typedef struct {
+    char source[MAX_PATH_SIZE];
+    char executable[MAX_PATH_SIZE];
+} CompiledGenerator;
+
+// One output line in a diff window; identity is decided on the whole line
+typedef struct {
+    const char *text; // First DIFF_MAX_LINE_LENGTH bytes at most
+    int text_length;
+    long length;      // Full line length
+    uint64_t hash;    // FNV-1a of the full line
+} DiffLine;
+
+typedef struct {
+    char *arena;      // Line text storage, DIFF_MAX_BYTES
+    size_t arena_used;
+    DiffLine *lines;  // At most DIFF_MAX_LINES
+    int num_lines;
+    long first_line;  // 1-based line number of lines[0]
+    int truncated;    // The output continues past the window
+} DiffSide;
+
+typedef struct {
+    char op; // ' ' common, '-' expected only, '+' actual only
+    int a;   // Index into the expected side
+    int b;   // Index into the actual side
+} DiffOp;
+
+typedef struct {
+    const char *name;
+    void (*emit)(FILE *out, uint64_t seed, long size);
+} BuiltinGenerator;
+
+// Incremental FNV-1a over program output, normalized by ignoring trailing whitespace
+typedef struct {
+    uint64_t hash;      // Hash up to the last non-whitespace byte
+    uint64_t ws_hash;   // Hash including the pending whitespace run
+    long length;        // Length up to the last non-whitespace byte
+    long ws_length;     // Length including the pending whitespace run
+} OutputHash;
+
+// Streaming comparison of actual output (pushed in chunks) against an expected stream.
+// Memory use is fixed no matter how long the output is.
+typedef struct {
+    ComparatorSpec spec;
+    FILE *expected;
+    long offset;              // Actual output bytes consumed
+    long mismatch_offset;     // Start of the first differing token, -1 while matching
+    int in_token;
+    long token_offset;
+    int token_equal;          // Current token byte-equal so far
+    int expected_token_ended; // Expected token was shorter than the actual one
+    int newlines;             // Line breaks in the actual separator before the next token
+    int exact_tail;           // Exact mode: only trailing whitespace may follow
+    long tail_offset;         // Where the trailing part started
+    char actual_token[MAX_COMPARE_TOKEN];
+    char expected_token[MAX_COMPARE_TOKEN];
+    int actual_length;
+    int expected_length;
+    char expected_buffer[COMPARE_BUFFER_SIZE]; // Window of the expected stream
+    size_t expected_pos;
+    size_t expected_fill;
+} OutputComparator;
+
+// Byte scanning primitives behind output hashing and comparison, picked per CPU at startup
+typedef struct {
+    const char *name;
+    size_t (*find_space)(const char *p, size_t n);     // Index of the first whitespace byte, or n
+    size_t (*skip_space)(const char *p, size_t n);     // Index of the first non-whitespace byte, or n
+    size_t (*count_newlines)(const char *p, size_t n);
+    size_t (*first_mismatch)(const char *a, const char *b, size_t n); // First differing index, or n
+} ByteKernels;
+
+typedef struct {
+    const char *program;    // Executable to run
+    const char *input;      // Literal stdin contents, used when input_fd < 0
+    int input_fd;           // Pre-opened stdin (e.g. a generator pipe), or -1
+    int spool_fd;           // Receives a copy of every output byte, or -1
+    int merge_stderr;       // Capture stderr with stdout; otherwise discard it
+    OutputComparator *comparator; // Fed every output chunk as it arrives, or NULL
+    int aborted;            // Killed at the comparator's first mismatch
+    long max_output_bytes;  // Kill past this many output bytes / lines; 0 = unlimited
+    long max_output_lines;
+    int output_limit_exceeded;
+    long output_lines;
+    OutputHash output_hash; // Filled in while the output streams
+    long output_bytes;      // Raw bytes the program printed
+    const char *interactor; // Judge process wired to the program's stdin/stdout, or NULL
+    int judge_data_fd;      // Test input handed to the interactor as fd 3
+    int judge_report_fd;    // Verdict report the interactor writes to fd 4
+    int judge_status;       // Interactor wait status
+    int judge_timed_out;
+    long queries;           // Lines the program sent to the interactor
+    long round_trips;       // Interactor replies followed by program output
+    long total_latency_us;  // Time from a delivered reply to the program's next output
+    long max_latency_us;
+    int wait_status;        // Program's wait status once reaped
+    int wall_timeout;       // Killed at TIMEOUT_SECONDS
+    int judge_rejected_first; // Killed because the interactor had already rejected it
+    struct rusage usage;    // Program's resource usage from wait4()
+    long peak_memory_kb;    // Largest VmPeak sampled while it ran
+} TestRun;
+
+// Prefix of a published suite segment; the TestSuite bytes follow immediately
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t suite_size; // Bytes of TestSuite data after the header
+    uint64_t suite_key;
+} SharedSuiteHeader;
+
+typedef struct {
+    uint64_t key;                     // Hash of (executable, input, limits)
+    int status;                       // 0 on success, -1 on timeout or execution error, RUN_OUTPUT_LIMIT
+    uint64_t output_hash;             // Normalized output hash (see OutputHash)
+    long output_length;               // Normalized output length
+    long output_bytes;                // Raw bytes printed (up to the kill, for RUN_OUTPUT_LIMIT)
+    Verdict verdict;                  // VERDICT_AC for a clean exit, otherwise why the run failed
+    int wait_status;                  // Raw wait status, for exit codes and signals in reports
+    char output_path[MAX_PATH_SIZE];  // Spooled output of the run
+} MemoEntry;
+
+// Referenced by the scalar_kernels table below
+size_t find_space_scalar(const char *p, size_t n);
+size_t skip_space_scalar(const char *p, size_t n);
+size_t count_newlines_scalar(const char *p, size_t n);
+size_t first_mismatch_scalar(const char *a, const char *b, size_t n);
+
 // --- Global State ---
 char executable_path[256];
-char temp_dir_path[256];
-TestSuite test_suite;
+char temp_dir_path[64]; // mkdtemp under /tmp or IN_MEMORY_TEMP_DIR; short, so paths built in it fit
+char suite_dir[MAX_PATH_SIZE];
+char reference_executable_path[MAX_PATH_SIZE];
+TestSuite *test_suite = NULL;     // Parse target; unused when attached to a shared copy
+const TestSuite *suite = NULL;
+int use_shared_suite = 0;
+CompiledGenerator compiled_generators[MAX_GENERATORS];
+int num_compiled_generators = 0;
+uint64_t executable_hash;
+uint64_t reference_hash;
+char checker_executable_path[MAX_PATH_SIZE];
+char interactor_executable_path[MAX_PATH_SIZE];
+PendingCheck pending_checks[MAX_PENDING_CHECKS];
+int num_pending_checks = 0;
+MemoEntry *memo_entries = NULL;
+int num_memo_entries = 0;
+int memo_capacity = 0;
+char memo_dir[MAX_PATH_SIZE]; // Optional on-disk run cache shared across evaluations
+MemoEntry aborted_run;       // Last run killed at a mismatch; not part of the memo
+MemoEntry interactive_run;   // Last interactive run; never memoized
+char results_path[MAX_PATH_SIZE] = RESULTS_JSON_PATH;
+int shard_index = 0;          // --shard i/N, 1-based; 0 when not sharding
+int shard_count = 0;
+const char *test_id_spec = NULL; // --tests list, e.g. "1,4,7-9"
+TestOutcome *test_outcomes = NULL;
+float target_score = -1.0f;   // --target-score: stop once the weighted score is settled
+char history_path[MAX_PATH_SIZE]; // --history: per-test failure counts across evaluations
+TestHistory *test_history = NULL;
+int num_test_history = 0;
+int num_sorted_history = 0;  // test_history[0..num_sorted_history) is sorted by key, without repeats
+int test_history_capacity = 0;
+char grade_store_dir[MAX_PATH_SIZE]; // --regrade: outcomes of earlier gradings, per submission
+uint64_t submission_key;             // Source and compiler configuration, see grade_submission_key
+StoredGrade *stored_grades = NULL;   // Sorted by test_key
+int num_stored_grades = 0;
+int stored_quality_valid = 0;        // The store also holds memory/robustness scores
+float stored_memory_score;
+float stored_robustness_score;
+ByteKernels scalar_kernels = {"scalar", find_space_scalar, skip_space_scalar,
+                              count_newlines_scalar, first_mismatch_scalar};
+ByteKernels byte_kernels; // Set by select_byte_kernels()
+const char *verdict_names[VERDICT_COUNT] = {"AC", "WA", "TLE-CPU", "TLE-wall", "MLE", "RE", "OLE", "JE"};
+CompileVariantSpec variant_specs[] = {
+    {"plain", ""},
+    {"asan", "-g -fsanitize=address -fno-omit-frame-pointer"},
+    {"gcov", "--coverage"},
+    {"pg", "-pg"},
+};
+const char *variant_list = NULL; // --variants; overrides the suite's compile_variants
+CompileProfile compile_profiles[] = {
+    {"fast-compile", "-O0"},
+    {"balanced", "-O1"},
+    {"release", "-O2"},
+    {"measure", "-O2 -march=native"},
+};
+const char *profile_option = NULL;        // --profile; overrides the suite's compile_profile
+const CompileProfile *compile_profile = &compile_profiles[0]; // Set by select_compile_profile()
+CompileVariant compile_variants[MAX_COMPILE_VARIANTS]; // Compile manifest; [0] is always plain
+int num_compile_variants = 0;
+long preprocess_ms = 0;
+int smoke_run = 0;                       // --smoke: tcc build, correctness tests only
+int in_memory = 0;                       // --in-memory: binaries, spools and logs live in memfds
+char memory_log_path[MAX_PATH_SIZE] = VALGRIND_LOG_PATH; // Valgrind/ASan report
+CompileVariantSpec smoke_variant_spec = {"tcc", ""};
+CompileProfile smoke_profile = {"tcc", ""};
+const char *compile_result_names[COMPILE_RESULT_COUNT] = {"ok", "compile-error", "compile-timeout", "compile-oom",
+                                                          "compile-output-limit"};
+CompileResult compile_result = COMPILE_OK; // Of preprocessing and the plain build; reported in the JSON
+pid_t compiler_pid = 0;                     // Compiler run_compiler is waiting on, for cleanup
+CompilerDiagnostic compiler_diagnostics[MAX_COMPILER_DIAGNOSTICS]; // Deduplicated across variants
+int num_compiler_diagnostics = 0;
+int compiler_diagnostics_dropped = 0;
+char pch_dir[MAX_PATH_SIZE];                      // --pch-dir: cached precompiled headers; empty = off
+const char *pch_include_list = DEFAULT_PCH_INCLUDES; // --pch-includes: the common-include set
+char pch_headers[256];                             // Common headers this source includes, if PCH-eligible
 
 // --- Function Prototypes ---
 void cleanup(void);
 void handle_signal(int sig);
+void command_init(Command *cmd, const char *program);
+void command_add(Command *cmd, const char *arg);
+void command_add_words(Command *cmd, const char *words);
+pid_t spawn_command(const Command *cmd, int stdin_fd, int stdout_fd, int stderr_fd, const char *env);
+int run_command(const Command *cmd, const char *input, int stdout_fd, int stderr_fd, const char *env);
+int remove_tree(const char *path);
+void build_compile_command(Command *cmd, const CompileVariant *variant, const char *forced_header,
+                           const char *input);
 long current_time_ms(void);
+long current_time_us(void);
 void set_child_resource_limits(void);
+void set_compiler_resource_limits(void);
+void command_init_compiler(Command *cmd, const char *program);
+int run_compiler(const Command *cmd, int stdout_fd, CompileResult *result);
+CompileResult finish_compile(int status, int timed_out, int diagnostics_fd, int report);
+int parse_compiler_diagnostic(const char *line, CompilerDiagnostic *diag);
+void record_compiler_diagnostics(const char *text, size_t len);
+int count_compiler_diagnostics(const char *severity);
 int compile_source(const char *source_filename);
-int run_test_process(const char *input, char *output_buffer, size_t buffer_size);
+int compile_source_smoke(const char *source_filename);
+int plan_compile_variants(const char *list);
+long estimate_suite_input_bytes(void);
+int select_compile_profile(const char *name);
+const char *variant_executable(const char *name);
+int pch_eligible_headers(const char *source_filename, char *headers, size_t headers_size);
+uint64_t compiler_identity_hash(void);
+int ensure_precompiled_header(const CompileVariant *variant, char *header_path, size_t header_size);
+void wait_for_variant_compiles(long start);
+float analyze_memory_asan(const char *asan_path, int mem_test);
+int run_test_process(TestRun *run);
+int run_interactive_process(TestRun *run);
+long read_peak_memory_kb(pid_t pid);
+void sample_peak_memory(TestRun *run, pid_t pid, long *last_sample_ms);
+Verdict classify_run(const TestRun *run);
+void describe_run_failure(const MemoEntry *run, char *buffer, size_t buffer_size);
+void record_verdict(EnhancedEvalMetrics *metrics, int index, Verdict verdict);
+uint64_t grade_submission_key(const char *source_file);
+uint64_t grade_test_key(const DynamicTestCase *tc, uint64_t judge_hash);
+int grade_store_path(char *path, size_t path_size);
+void load_stored_grades(void);
+StoredGrade *find_stored_grade(uint64_t key);
+int mark_stored_tests(const char *source_file);
+void apply_stored_grade(EnhancedEvalMetrics *metrics, int index, float *passed_weight);
+void save_stored_grades(const EnhancedEvalMetrics *metrics);
 int load_test_cases_from_json(const char *json_file);
+int load_test_suite(const char *json_file);
+size_t suite_size_bytes(int num_tests);
+uint64_t suite_cache_key(const char *json_file);
+int attach_shared_suite(uint64_t key);
+void publish_shared_suite(uint64_t key);
 float calculate_dynamic_passrate(EnhancedEvalMetrics *metrics);
 float analyze_memory(void);
 float check_robustness(void);
 void write_enhanced_results_to_json(const EnhancedEvalMetrics *metrics);
 void trim_trailing_whitespace(char *str);
 void print_test_suite_info(void);
+int is_generated_test(const DynamicTestCase *tc);
+BuiltinGenerator *find_builtin_generator(const char *name);
+int resolve_suite_path(const char *path, char *resolved, size_t resolved_size);
+int compile_auxiliary_program(const char *source_filename, const char *output_path);
+int spawn_input_generator(const DynamicTestCase *tc, pid_t *gen_pid);
+int ensure_reference_compiled(void);
+void read_output_preview(const char *path, char *buffer, size_t buffer_size);
+int judge_test(int index, MemoEntry **actual_run, long *mismatch_offset, int *reused);
+void record_failure_detail(EnhancedEvalMetrics *metrics, const char *fmt, ...);
+void output_hash_init(OutputHash *h);
+void output_hash_update(OutputHash *h, const char *data, size_t len);
+uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t len);
+uint64_t hash_file_contents(const char *path);
+uint64_t run_memo_key(uint64_t program_hash, const DynamicTestCase *tc);
+MemoEntry *memo_lookup(uint64_t key);
+MemoEntry *memo_add(uint64_t key, int status);
+MemoEntry *run_memoized(const DynamicTestCase *tc, const char *program, uint64_t program_hash,
+                        int merge_stderr, int *reused, OutputComparator *comparator);
+int parse_comparator_spec(json_object *obj, ComparatorSpec *spec);
+const char *comparator_mode_name(CompareMode mode);
+void comparator_init(OutputComparator *cmp, const ComparatorSpec *spec, FILE *expected);
+void comparator_feed(OutputComparator *cmp, const char *data, size_t len);
+int comparator_feed_file(OutputComparator *cmp, const char *path);
+int comparator_finish(OutputComparator *cmp);
+FILE *open_string_stream(const char *text);
+void select_byte_kernels(void);
+int benchmark_byte_kernels(long max_size);
+int is_partial_run(void);
+int *schedule_tests(int *count);
+void load_test_history(void);
+void save_test_history(void);
+void record_test_history(const DynamicTestCase *tc, int passed);
+int select_tests(void);
+int merge_partial_results(const char *output_path, int num_partials, char **partial_paths);
+char *normalize_source(const char *path, size_t *length);
+int has_local_include(const char *normalized, size_t length);
+int batch_result_path(const char *results_dir, const char *source, char *path, size_t path_size);
+int run_batch(const char *suite_file, const char *results_dir, int num_sources, char **sources,
+              int num_options, char **options);
+int run_self_checks(void);
+void fprint_json_string(FILE *f, const char *s, size_t len);
+char *build_failure_diff(int index, const MemoEntry *actual);
+int ensure_checker_compiled(void);
+int create_data_memfd(const char *name, const char *data, size_t len);
+void memfd_path(int fd, char *path, size_t path_size);
+int memfd_path_fd(const char *path);
+void remove_spool(const char *path);
+int load_executables_into_memfds(void);
+void exec_program(const char *program, int program_fd, char *const argv[]);
+int open_checker_input(const DynamicTestCase *tc);
+int launch_checker(int index, const MemoEntry *actual);
+float pending_check_weight(void);
+void settle_checks(EnhancedEvalMetrics *metrics, float *passed_weight, int max_pending);
+void finish_check(EnhancedEvalMetrics *metrics, const PendingCheck *check, int wait_status,
+                  int timed_out, float *passed_weight);
+int ensure_interactor_compiled(void);
+int judge_interactive_test(EnhancedEvalMetrics *metrics, int index, float *passed_weight,
+                           MemoEntry **actual_run);
 
 // --- JSON Loading Functions ---
 
@@ -91,6 +641,16 @@ int load_test_cases_from_json(const char *json_file) {
         return -1;
     }
 
+    // Generator and reference paths are relative to the suite file. Its absolute directory is
+    // used, so a suite published with --shared-suite holds paths valid from any working directory.
+    char *abs_json = realpath(json_file, NULL);
+    const char *suite_path = abs_json ? abs_json : json_file;
+    const char *last_slash = strrchr(suite_path, '/');
+    if (last_slash) {
+        snprintf(suite_dir, sizeof(suite_dir), "%.*s", (int)(last_slash - suite_path), suite_path);
+    }
+    free(abs_json);
+
     // Read entire file
     fseek(file, 0, SEEK_END);
     long file_size = ftell(file);
@@ -114,63 +674,191 @@ int load_test_cases_from_json(const char *json_file) {
         return -1;
     }
 
-    // Extract program metadata
+    // Extract test cases
     json_object *desc_obj, *type_obj, *diff_obj, *tests_obj;
-    
+    if (!json_object_object_get_ex(root, "test_cases", &tests_obj)) {
+        fprintf(stderr, "❌ No test_cases found in JSON\n");
+        json_object_put(root);
+        free(json_string);
+        return -1;
+    }
+
+    int array_len = json_object_array_length(tests_obj);
+    int num_tests = (array_len > MAX_TESTS) ? MAX_TESTS : array_len;
+    test_suite = calloc(1, suite_size_bytes(num_tests));
+    if (!test_suite) {
+        perror("calloc for test suite failed");
+        json_object_put(root);
+        free(json_string);
+        return -1;
+    }
+    test_suite->num_tests = num_tests;
+
+    // Extract program metadata
     if (json_object_object_get_ex(root, "program_description", &desc_obj)) {
-        strncpy(test_suite.program_description, json_object_get_string(desc_obj), 
-                sizeof(test_suite.program_description) - 1);
+        strncpy(test_suite->program_description, json_object_get_string(desc_obj), 
+                sizeof(test_suite->program_description) - 1);
     }
     
     if (json_object_object_get_ex(root, "program_type", &type_obj)) {
-        strncpy(test_suite.program_type, json_object_get_string(type_obj), 
-                sizeof(test_suite.program_type) - 1);
+        strncpy(test_suite->program_type, json_object_get_string(type_obj), 
+                sizeof(test_suite->program_type) - 1);
     }
     
     if (json_object_object_get_ex(root, "difficulty_level", &diff_obj)) {
-        strncpy(test_suite.difficulty_level, json_object_get_string(diff_obj), 
-                sizeof(test_suite.difficulty_level) - 1);
+        strncpy(test_suite->difficulty_level, json_object_get_string(diff_obj), 
+                sizeof(test_suite->difficulty_level) - 1);
     }
 
-    // Extract test cases
-    if (!json_object_object_get_ex(root, "test_cases", &tests_obj)) {
-        fprintf(stderr, "❌ No test_cases found in JSON\n");
+    json_object *ref_obj;
+    if (json_object_object_get_ex(root, "reference_source", &ref_obj)) {
+        if (resolve_suite_path(json_object_get_string(ref_obj), test_suite->reference_source,
+                               sizeof(test_suite->reference_source)) != 0) {
+            json_object_put(root);
+            free(json_string);
+            return -1;
+        }
+    }
+
+    json_object *checker_obj;
+    if (json_object_object_get_ex(root, "checker", &checker_obj)) {
+        if (resolve_suite_path(json_object_get_string(checker_obj), test_suite->checker_source,
+                               sizeof(test_suite->checker_source)) != 0) {
+            json_object_put(root);
+            free(json_string);
+            return -1;
+        }
+    }
+    json_object *interactor_obj;
+    if (json_object_object_get_ex(root, "interactor", &interactor_obj)) {
+        if (resolve_suite_path(json_object_get_string(interactor_obj), test_suite->interactor_source,
+                               sizeof(test_suite->interactor_source)) != 0) {
+            json_object_put(root);
+            free(json_string);
+            return -1;
+        }
+    }
+
+    json_object *profile_obj;
+    if (json_object_object_get_ex(root, "compile_profile", &profile_obj)) {
+        snprintf(test_suite->compile_profile, sizeof(test_suite->compile_profile), "%s",
+                 json_object_get_string(profile_obj));
+    }
+
+    // "compile_variants": ["asan", "gcov"] or "asan,gcov"
+    json_object *variants_obj;
+    if (json_object_object_get_ex(root, "compile_variants", &variants_obj)) {
+        if (json_object_is_type(variants_obj, json_type_array)) {
+            for (int v = 0; v < (int)json_object_array_length(variants_obj); v++) {
+                size_t used = strlen(test_suite->compile_variants);
+                snprintf(test_suite->compile_variants + used, sizeof(test_suite->compile_variants) - used,
+                         "%s%s", used ? "," : "", json_object_get_string(json_object_array_get_idx(variants_obj, v)));
+            }
+        } else {
+            snprintf(test_suite->compile_variants, sizeof(test_suite->compile_variants), "%s",
+                     json_object_get_string(variants_obj));
+        }
+    }
+
+    // "comparator": "exact" | "whitespace" | "token" | "numeric", or
+    // {"mode": "numeric", "abs_epsilon": 1e-6, "rel_epsilon": 1e-6}
+    test_suite->comparator = (ComparatorSpec){COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON};
+    json_object *cmp_obj;
+    if (json_object_object_get_ex(root, "comparator", &cmp_obj) &&
+        parse_comparator_spec(cmp_obj, &test_suite->comparator) != 0) {
         json_object_put(root);
         free(json_string);
         return -1;
     }
 
-    int array_len = json_object_array_length(tests_obj);
-    test_suite.num_tests = (array_len > MAX_TESTS) ? MAX_TESTS : array_len;
+    json_object *limit_obj;
+    test_suite->output_limit_bytes = json_object_object_get_ex(root, "output_limit_bytes", &limit_obj)
+        ? (long)json_object_get_int64(limit_obj) : DEFAULT_OUTPUT_LIMIT_BYTES;
+    test_suite->output_limit_lines = json_object_object_get_ex(root, "output_limit_lines", &limit_obj)
+        ? (long)json_object_get_int64(limit_obj) : DEFAULT_OUTPUT_LIMIT_LINES;
 
-    for (int i = 0; i < test_suite.num_tests; i++) {
+    for (int i = 0; i < test_suite->num_tests; i++) {
         json_object *test_obj = json_object_array_get_idx(tests_obj, i);
         json_object *input_obj, *output_obj, *desc_obj_tc, *cat_obj, *weight_obj;
+        json_object *gen_obj, *seed_obj, *size_obj;
 
         if (json_object_object_get_ex(test_obj, "input", &input_obj)) {
-            strncpy(test_suite.tests[i].input, json_object_get_string(input_obj), 
-                    sizeof(test_suite.tests[i].input) - 1);
+            strncpy(test_suite->tests[i].input, json_object_get_string(input_obj), 
+                    sizeof(test_suite->tests[i].input) - 1);
         }
 
         if (json_object_object_get_ex(test_obj, "expected_output", &output_obj)) {
-            strncpy(test_suite.tests[i].expected_output, json_object_get_string(output_obj), 
-                    sizeof(test_suite.tests[i].expected_output) - 1);
+            strncpy(test_suite->tests[i].expected_output, json_object_get_string(output_obj), 
+                    sizeof(test_suite->tests[i].expected_output) - 1);
         }
 
+        // Live runs are judged by the streaming comparator; this hash only lets judge_test pass
+        // a reused exact-mode run without reading its spool back
+        OutputHash expected_hash;
+        output_hash_init(&expected_hash);
+        output_hash_update(&expected_hash, test_suite->tests[i].expected_output,
+                           strlen(test_suite->tests[i].expected_output));
+        test_suite->tests[i].expected_hash = expected_hash.hash;
+        test_suite->tests[i].expected_length = expected_hash.length;
+
         if (json_object_object_get_ex(test_obj, "description", &desc_obj_tc)) {
-            strncpy(test_suite.tests[i].description, json_object_get_string(desc_obj_tc), 
-                    sizeof(test_suite.tests[i].description) - 1);
+            strncpy(test_suite->tests[i].description, json_object_get_string(desc_obj_tc), 
+                    sizeof(test_suite->tests[i].description) - 1);
         }
 
         if (json_object_object_get_ex(test_obj, "category", &cat_obj)) {
-            strncpy(test_suite.tests[i].category, json_object_get_string(cat_obj), 
-                    sizeof(test_suite.tests[i].category) - 1);
+            strncpy(test_suite->tests[i].category, json_object_get_string(cat_obj), 
+                    sizeof(test_suite->tests[i].category) - 1);
         }
 
         if (json_object_object_get_ex(test_obj, "weight", &weight_obj)) {
-            test_suite.tests[i].weight = json_object_get_double(weight_obj);
+            test_suite->tests[i].weight = json_object_get_double(weight_obj);
         } else {
-            test_suite.tests[i].weight = 1.0; // Default weight
+            test_suite->tests[i].weight = 1.0; // Default weight
+        }
+
+        test_suite->tests[i].output_limit_bytes =
+            json_object_object_get_ex(test_obj, "output_limit_bytes", &limit_obj)
+            ? (long)json_object_get_int64(limit_obj) : test_suite->output_limit_bytes;
+        test_suite->tests[i].output_limit_lines =
+            json_object_object_get_ex(test_obj, "output_limit_lines", &limit_obj)
+            ? (long)json_object_get_int64(limit_obj) : test_suite->output_limit_lines;
+
+        test_suite->tests[i].comparator = test_suite->comparator;
+        if (json_object_object_get_ex(test_obj, "comparator", &cmp_obj) &&
+            parse_comparator_spec(cmp_obj, &test_suite->tests[i].comparator) != 0) {
+            fprintf(stderr, "❌ Invalid comparator for test %d\n", i + 1);
+            json_object_put(root);
+            free(json_string);
+            return -1;
+        }
+
+        // Generated input: {"generator": "random_ints" | "gen.c", "seed": N, "size": N}
+        if (json_object_object_get_ex(test_obj, "generator", &gen_obj)) {
+            const char *gen_name = json_object_get_string(gen_obj);
+            if (strstr(gen_name, ".c") || strchr(gen_name, '/')) {
+                if (resolve_suite_path(gen_name, test_suite->tests[i].generator,
+                                       sizeof(test_suite->tests[i].generator)) != 0) {
+                    json_object_put(root);
+                    free(json_string);
+                    return -1;
+                }
+            } else {
+                strncpy(test_suite->tests[i].generator, gen_name,
+                        sizeof(test_suite->tests[i].generator) - 1);
+            }
+            test_suite->tests[i].seed = json_object_object_get_ex(test_obj, "seed", &seed_obj)
+                ? (uint64_t)json_object_get_int64(seed_obj) : 0;
+            test_suite->tests[i].gen_size = json_object_object_get_ex(test_obj, "size", &size_obj)
+                ? (long)json_object_get_int64(size_obj) : DEFAULT_GENERATOR_SIZE;
+
+            // An interactor reads the generated input itself; no expected output is needed
+            if (test_suite->reference_source[0] == '\0' && test_suite->interactor_source[0] == '\0') {
+                fprintf(stderr, "❌ Test %d uses a generator but the suite has no reference_source\n", i + 1);
+                json_object_put(root);
+                free(json_string);
+                return -1;
+            }
         }
     }
 
@@ -178,17 +866,142 @@ int load_test_cases_from_json(const char *json_file) {
     json_object *edge_cases_obj;
     if (json_object_object_get_ex(root, "potential_edge_cases", &edge_cases_obj)) {
         int edge_array_len = json_object_array_length(edge_cases_obj);
-        test_suite.num_edge_cases = (edge_array_len > MAX_TESTS) ? MAX_TESTS : edge_array_len;
+        test_suite->num_edge_cases = (edge_array_len > MAX_EDGE_CASES) ? MAX_EDGE_CASES : edge_array_len;
         
-        for (int i = 0; i < test_suite.num_edge_cases; i++) {
+        for (int i = 0; i < test_suite->num_edge_cases; i++) {
             json_object *edge_obj = json_object_array_get_idx(edge_cases_obj, i);
-            strncpy(test_suite.potential_edge_cases[i], json_object_get_string(edge_obj), 
-                    sizeof(test_suite.potential_edge_cases[i]) - 1);
+            strncpy(test_suite->potential_edge_cases[i], json_object_get_string(edge_obj), 
+                    sizeof(test_suite->potential_edge_cases[i]) - 1);
         }
     }
 
     json_object_put(root);
     free(json_string);
+    suite = test_suite;
+    return 0;
+}
+
+/**
+ * @brief Bytes needed for a suite holding num_tests tests.
+ */
+size_t suite_size_bytes(int num_tests) {
+    return sizeof(TestSuite) + (size_t)num_tests * sizeof(DynamicTestCase);
+}
+
+/**
+ * @brief Hashes the suite file together with its directory and this build's TestSuite layout.
+ * @return The cache key, or 0 if the file cannot be read.
+ */
+uint64_t suite_cache_key(const char *json_file) {
+    FILE *file = fopen(json_file, "rb");
+    if (!file) return 0;
+
+    uint32_t layout[] = {sizeof(TestSuite), sizeof(DynamicTestCase)};
+    uint64_t key = fnv1a_hash(FNV_OFFSET_BASIS, layout, sizeof(layout));
+
+    // Relative generator/reference paths resolve against the suite directory
+    char *abs_path = realpath(json_file, NULL);
+    if (abs_path) {
+        const char *last_slash = strrchr(abs_path, '/');
+        key = fnv1a_hash(key, abs_path, last_slash - abs_path);
+        free(abs_path);
+    }
+
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        key = fnv1a_hash(key, buf, n);
+    }
+    fclose(file);
+    return key;
+}
+
+/**
+ * @brief Maps a suite published by another evaluator read-only.
+ *
+ * The path is predictable, so only a file we own and nobody else can write is trusted: a
+ * planted suite could name its own checker or generator, which would then be compiled and run.
+ * @return 0 if attached, -1 if no valid copy exists.
+ */
+int attach_shared_suite(uint64_t key) {
+    char path[MAX_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/eval_suite_%016llx", SHARED_SUITE_DIR, (unsigned long long)key);
+
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 022) != 0 ||
+        (size_t)st.st_size < sizeof(SharedSuiteHeader) + sizeof(TestSuite)) {
+        close(fd);
+        return -1;
+    }
+    size_t map_size = st.st_size;
+
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const SharedSuiteHeader *header = map;
+    const TestSuite *shared = (const TestSuite *)((const char *)map + sizeof(SharedSuiteHeader));
+    if (header->magic != SHARED_SUITE_MAGIC || header->suite_key != key ||
+        header->suite_size != map_size - sizeof(SharedSuiteHeader) ||
+        header->suite_size != suite_size_bytes(shared->num_tests)) {
+        munmap(map, map_size);
+        return -1;
+    }
+
+    // The mapping lives for the rest of the process
+    suite = shared;
+    return 0;
+}
+
+/**
+ * @brief Publishes the parsed suite for other evaluators on this host.
+ *
+ * Written under a per-process name and renamed into place, so attachers never see a
+ * partially written segment.
+ */
+void publish_shared_suite(uint64_t key) {
+    char path[MAX_PATH_SIZE], tmp_path[MAX_PATH_SIZE + 32];
+    snprintf(path, sizeof(path), "%s/eval_suite_%016llx", SHARED_SUITE_DIR, (unsigned long long)key);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    // Exclusive and private: a file already sitting at the temp name is not ours to write into
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    FILE *f = fd == -1 ? NULL : fdopen(fd, "wb");
+    if (!f) {
+        perror("open (shared suite)");
+        if (fd != -1) close(fd);
+        return;
+    }
+
+    size_t suite_size = suite_size_bytes(test_suite->num_tests);
+    SharedSuiteHeader header = {SHARED_SUITE_MAGIC, 0, suite_size, key};
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(test_suite, suite_size, 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("publish shared suite");
+        remove(tmp_path);
+    }
+}
+
+/**
+ * @brief Loads the test suite, attaching to a shared copy first when --shared-suite is set.
+ */
+int load_test_suite(const char *json_file) {
+    if (!use_shared_suite) return load_test_cases_from_json(json_file);
+
+    uint64_t key = suite_cache_key(json_file);
+    if (key != 0 && attach_shared_suite(key) == 0) {
+        printf("    📎 Attached to shared suite %016llx\n", (unsigned long long)key);
+        return 0;
+    }
+
+    if (load_test_cases_from_json(json_file) != 0) return -1;
+    if (key != 0) publish_shared_suite(key);
     return 0;
 }
 
@@ -202,71 +1015,200 @@ float calculate_dynamic_passrate(EnhancedEvalMetrics *metrics) {
     
     float total_weight = 0.0f;
     float passed_weight = 0.0f;
+    float remaining_weight = 0.0f;
+    int num_scheduled = 0;
+    int *order = schedule_tests(&num_scheduled);
+    if (!order) return 0.0f;
+
+    // Unchanged tests count from the grade store and are left out of the schedule
+    for (int i = 0; i < suite->num_tests; i++) {
+        if (!test_outcomes[i].from_store) continue;
+        total_weight += suite->tests[i].weight;
+        apply_stored_grade(metrics, i, &passed_weight);
+    }
+    if (metrics->stored_results > 0) {
+        printf("    ♻️  %d test(s) unchanged since the stored grade\n", metrics->stored_results);
+    }
+
+    for (int k = 0; k < num_scheduled; k++) {
+        remaining_weight += suite->tests[order[k]].weight;
+    }
+    float selected_weight = remaining_weight + total_weight;
+
+    if (target_score >= 0) {
+        printf("    🎯 Target weighted score %.1f%%: heaviest and most failure-prone tests first\n", target_score);
+    }
+    if (is_partial_run()) {
+        printf("    Running %d of %d LLM-generated test cases:\n", metrics->tests_run, suite->num_tests);
+    } else {
+        printf("    Running %d LLM-generated test cases:\n", suite->num_tests);
+    }
     
-    printf("    Running %d LLM-generated test cases:\n", test_suite.num_tests);
-    
-    for (int i = 0; i < test_suite.num_tests; i++) {
-        char output_buf[MAX_OUTPUT_SIZE] = {0};
-        total_weight += test_suite.tests[i].weight;
-        
-        printf("    Test %d [%s]: %s\n", i + 1, test_suite.tests[i].category, 
-               test_suite.tests[i].description);
+    int executed = 0;
+    for (; executed < num_scheduled; executed++) {
+        settle_checks(metrics, &passed_weight, MAX_PENDING_CHECKS);
+
+        if (target_score >= 0 && selected_weight > 0) {
+            float lower = passed_weight / selected_weight * 100.0f;
+            float upper = (passed_weight + remaining_weight + pending_check_weight()) / selected_weight * 100.0f;
+            if (lower >= target_score || upper < target_score) {
+                // Outstanding checks can't change the decision, only narrow the bounds
+                settle_checks(metrics, &passed_weight, 0);
+                lower = passed_weight / selected_weight * 100.0f;
+                upper = (passed_weight + remaining_weight) / selected_weight * 100.0f;
+                metrics->early_stop = lower >= target_score ? "reached" : "unreachable";
+                metrics->score_lower_bound = lower;
+                metrics->score_upper_bound = upper;
+                break;
+            }
+        }
+
+        int i = order[executed];
+        const DynamicTestCase *tc = &suite->tests[i];
+        MemoEntry *actual = NULL;
+        long mismatch_offset = -1;
+        int reused = 0;
+        total_weight += tc->weight;
+        remaining_weight -= tc->weight;
         
-        if (run_test_process(test_suite.tests[i].input, output_buf, sizeof(output_buf)) == 0) {
-            trim_trailing_whitespace(output_buf);
-            
-            if (strcmp(output_buf, test_suite.tests[i].expected_output) == 0) {
-                printf("      ✅ PASS\n");
-                metrics->tests_passed++;
-                passed_weight += test_suite.tests[i].weight;
-            } else {
-                printf("      ❌ FAIL - Expected: '%s', Got: '%s'\n", 
-                       test_suite.tests[i].expected_output, output_buf);
-                metrics->tests_failed++;
-                
-                // Record failure details
-                if (metrics->num_failed_details < MAX_TESTS) {
-                    snprintf(metrics->failed_tests[metrics->num_failed_details], 512,
-                             "Test %d (%s): Expected '%s', Got '%s'", 
-                             i + 1, test_suite.tests[i].description,
-                             test_suite.tests[i].expected_output, output_buf);
-                    metrics->num_failed_details++;
-                }
+        printf("    Test %d [%s]: %s\n", i + 1, tc->category, tc->description);
+
+        int result = suite->interactor_source[0] != '\0'
+            ? judge_interactive_test(metrics, i, &passed_weight, &actual)
+            : judge_test(i, &actual, &mismatch_offset, &reused);
+        if (result == JUDGE_DECIDED) continue;
+        if (reused) {
+            printf("      ♻️  Reusing memoized run of identical input\n");
+            metrics->reused_results++;
+        }
+
+        if (result == JUDGE_NEEDS_CHECKER) {
+            // Make room first, so at most MAX_PENDING_CHECKS run beside the next test
+            settle_checks(metrics, &passed_weight, MAX_PENDING_CHECKS - 1);
+            if (launch_checker(i, actual) == 0) {
+                printf("      🔍 Output handed to the checker\n");
+                continue;
             }
+            result = -1;
+        }
+
+        record_test_history(tc, result == 0);
+        if (result == -1) {
+            // A failed run says why; otherwise the reference or checker could not be run
+            record_verdict(metrics, i, actual && actual->verdict != VERDICT_AC ? actual->verdict : VERDICT_JE);
         } else {
-            printf("      ❌ FAIL - Timeout or execution error\n");
-            metrics->tests_failed++;
-            
-            if (metrics->num_failed_details < MAX_TESTS) {
-                snprintf(metrics->failed_tests[metrics->num_failed_details], 512,
-                         "Test %d (%s): Execution timeout or error", 
-                         i + 1, test_suite.tests[i].description);
-                metrics->num_failed_details++;
-            }
+            record_verdict(metrics, i, result == 0 ? VERDICT_AC : result == JUDGE_OUTPUT_LIMIT ? VERDICT_OLE : VERDICT_WA);
+        }
+        if (result == 0) {
+            printf("      ✅ PASS\n");
+            metrics->tests_passed++;
+            passed_weight += tc->weight;
+            test_outcomes[i].passed = 1;
+            test_outcomes[i].score = 1.0f;
+            continue;
+        }
+
+        metrics->tests_failed++;
+        if (result == JUDGE_OUTPUT_LIMIT) {
+            printf("      ❌ FAIL - Output limit exceeded: killed after %ld bytes (limit %ld bytes",
+                   actual->output_bytes, tc->output_limit_bytes);
+            if (tc->output_limit_lines > 0) printf(", %ld lines", tc->output_limit_lines);
+            printf(")\n");
+            record_failure_detail(metrics, "Test %d (%s): Output limit exceeded (OLE) after %ld bytes",
+                                  i + 1, tc->description, actual->output_bytes);
+            metrics->output_limit_exceeded++;
+            test_outcomes[i].output_limit_exceeded = 1;
+            test_outcomes[i].output_bytes = actual->output_bytes;
+            continue;
+        }
+        const char *stopped = (result == JUDGE_WRONG_OUTPUT && actual->status == RUN_ABORTED)
+                              ? ", run stopped early" : "";
+        if (result == JUDGE_WRONG_OUTPUT && metrics->num_failed_diffs < MAX_FAILED_DETAILS) {
+            char *diff = build_failure_diff(i, actual);
+            if (diff) metrics->failed_diffs[metrics->num_failed_diffs++] = diff;
+        }
+        if (result == JUDGE_WRONG_OUTPUT && is_generated_test(tc)) {
+            printf("      ❌ FAIL - Output differs from reference at byte %ld%s\n", mismatch_offset, stopped);
+            record_failure_detail(metrics,
+                                  "Test %d (%s): Output differs from reference at byte %ld%s (generator %s, seed %llu, size %ld)",
+                                  i + 1, tc->description, mismatch_offset, stopped, tc->generator,
+                                  (unsigned long long)tc->seed, tc->gen_size);
+        } else if (result == JUDGE_WRONG_OUTPUT) {
+            char output_buf[MAX_OUTPUT_SIZE];
+            read_output_preview(actual->output_path, output_buf, sizeof(output_buf));
+            printf("      ❌ FAIL - Expected: '%s', Got: '%s' (differs at byte %ld%s)\n",
+                   tc->expected_output, output_buf, mismatch_offset, stopped);
+            record_failure_detail(metrics, "Test %d (%s): Expected '%s', Got '%s' (differs at byte %ld%s)",
+                                  i + 1, tc->description, tc->expected_output, output_buf,
+                                  mismatch_offset, stopped);
+        } else if (test_outcomes[i].verdict == VERDICT_JE) {
+            printf("      ❌ FAIL - Judge error: the reference, checker or interactor could not be run\n");
+            record_failure_detail(metrics, "Test %d (%s): Judge error (JE)", i + 1, tc->description);
+        } else {
+            char reason[128];
+            describe_run_failure(actual, reason, sizeof(reason));
+            printf("      ❌ FAIL - %s\n", reason);
+            record_failure_detail(metrics, "Test %d (%s): %s", i + 1, tc->description, reason);
         }
     }
+    settle_checks(metrics, &passed_weight, 0);
     
+    if (metrics->early_stop) {
+        printf("    🛑 Target %.1f%% %s after %d of %d tests (weighted score between %.1f%% and %.1f%%)\n",
+               target_score, metrics->early_stop, executed, num_scheduled,
+               metrics->score_lower_bound, metrics->score_upper_bound);
+        // Tests that never ran are reported as not selected
+        for (int k = executed; k < num_scheduled; k++) {
+            test_outcomes[order[k]].selected = 0;
+        }
+        metrics->tests_run = executed + metrics->stored_results; // Stored tests were answered, not skipped
+    }
+    free(order);
+    if (history_path[0]) save_test_history();
+
     // Calculate both simple and weighted scores
-    float simple_passrate = (test_suite.num_tests > 0) ? (float)metrics->tests_passed / test_suite.num_tests * 100.0f : 0.0f;
+    float simple_passrate = (metrics->tests_run > 0) ? (float)metrics->tests_passed / metrics->tests_run * 100.0f : 0.0f;
     metrics->weighted_score = (total_weight > 0) ? (passed_weight / total_weight * 100.0f) : 0.0f;
     
     return simple_passrate;
 }
 
+/**
+ * @brief Appends a line to the failed test details, if there is room left.
+ */
+void record_failure_detail(EnhancedEvalMetrics *metrics, const char *fmt, ...) {
+    if (metrics->num_failed_details >= MAX_FAILED_DETAILS) return;
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(metrics->failed_tests[metrics->num_failed_details], sizeof(metrics->failed_tests[0]),
+              fmt, args);
+    va_end(args);
+    metrics->num_failed_details++;
+}
+
 /**
  * @brief Prints information about the loaded test suite
  */
 void print_test_suite_info(void) {
     printf("📋 Test Suite Information:\n");
-    printf("    Program: %s\n", test_suite.program_description);
-    printf("    Type: %s\n", test_suite.program_type);
-    printf("    Difficulty: %s\n", test_suite.difficulty_level);
-    printf("    Tests: %d test cases loaded\n", test_suite.num_tests);
+    printf("    Program: %s\n", suite->program_description);
+    printf("    Type: %s\n", suite->program_type);
+    printf("    Difficulty: %s\n", suite->difficulty_level);
+    printf("    Tests: %d test cases loaded\n", suite->num_tests);
+    if (suite->comparator.mode != COMPARE_EXACT) {
+        printf("    Comparator: %s\n", comparator_mode_name(suite->comparator.mode));
+    }
+    if (suite->interactor_source[0] != '\0') {
+        printf("    Interactor: %s\n", suite->interactor_source);
+    } else if (suite->checker_source[0] != '\0') {
+        printf("    Checker: %s\n", suite->checker_source);
+    }
     
-    if (test_suite.num_edge_cases > 0) {
+    if (suite->num_edge_cases > 0) {
         printf("    Edge Cases to Consider:\n");
-        for (int i = 0; i < test_suite.num_edge_cases; i++) {
-            printf("      • %s\n", test_suite.potential_edge_cases[i]);
+        for (int i = 0; i < suite->num_edge_cases; i++) {
+            printf("      • %s\n", suite->potential_edge_cases[i]);
         }
     }
     printf("\n");
@@ -276,39 +1218,135 @@ void print_test_suite_info(void) {
  * @brief Enhanced results output with detailed failure information
  */
 void write_enhanced_results_to_json(const EnhancedEvalMetrics *metrics) {
-    FILE *f = fopen(RESULTS_JSON_PATH, "w");
+    FILE *f = fopen(results_path, "w");
     if (!f) {
         perror("fopen (results.json)");
         return;
     }
     
     fprintf(f, "{\n");
-    fprintf(f, "  \"program_description\": \"%s\",\n", test_suite.program_description);
-    fprintf(f, "  \"program_type\": \"%s\",\n", test_suite.program_type);
-    fprintf(f, "  \"difficulty_level\": \"%s\",\n", test_suite.difficulty_level);
+    fprintf(f, "  \"program_description\": ");
+    fprint_json_string(f, suite->program_description, strlen(suite->program_description));
+    fprintf(f, ",\n  \"program_type\": ");
+    fprint_json_string(f, suite->program_type, strlen(suite->program_type));
+    fprintf(f, ",\n  \"difficulty_level\": ");
+    fprint_json_string(f, suite->difficulty_level, strlen(suite->difficulty_level));
+    fprintf(f, ",\n");
     fprintf(f, "  \"passrate\": %.1f,\n", metrics->passrate);
     fprintf(f, "  \"weighted_score\": %.1f,\n", metrics->weighted_score);
-    fprintf(f, "  \"memory_score\": %.1f,\n", metrics->memory_score);
-    fprintf(f, "  \"robustness_score\": %.1f,\n", metrics->robustness_score);
+    if (metrics->quality_checks_skipped) {
+        fprintf(f, "  \"memory_score\": null,\n");
+        fprintf(f, "  \"robustness_score\": null,\n");
+    } else {
+        fprintf(f, "  \"memory_score\": %.1f,\n", metrics->memory_score);
+        fprintf(f, "  \"robustness_score\": %.1f,\n", metrics->robustness_score);
+    }
     fprintf(f, "  \"tests_passed\": %d,\n", metrics->tests_passed);
     fprintf(f, "  \"tests_failed\": %d,\n", metrics->tests_failed);
-    fprintf(f, "  \"total_tests\": %d,\n", test_suite.num_tests);
+    fprintf(f, "  \"total_tests\": %d,\n", metrics->tests_run);
+    fprintf(f, "  \"suite_tests\": %d,\n", suite->num_tests);
+    fprintf(f, "  \"partial\": %s,\n", is_partial_run() || metrics->early_stop ? "true" : "false");
+    if (metrics->early_stop) {
+        fprintf(f, "  \"early_stop\": \"%s\",\n", metrics->early_stop);
+        fprintf(f, "  \"target_score\": %.1f,\n", target_score);
+        fprintf(f, "  \"weighted_score_bounds\": [%.1f, %.1f],\n",
+                metrics->score_lower_bound, metrics->score_upper_bound);
+    }
+    if (shard_count > 0) {
+        fprintf(f, "  \"shard\": \"%d/%d\",\n", shard_index, shard_count);
+    }
     fprintf(f, "  \"execution_time_ms\": %ld,\n", metrics->execution_time_ms);
+    fprintf(f, "  \"reused_results\": %d,\n", metrics->reused_results);
+    if (smoke_run) fprintf(f, "  \"smoke_run\": true,\n");
+    if (in_memory) fprintf(f, "  \"in_memory\": true,\n");
+    fprintf(f, "  \"compile_result\": \"%s\",\n", compile_result_names[compile_result]);
+    fprintf(f, "  \"compiler_diagnostics\": [");
+    for (int i = 0; i < num_compiler_diagnostics; i++) {
+        const CompilerDiagnostic *d = &compiler_diagnostics[i];
+        fprintf(f, "%s\n    {\"file\": ", i ? "," : "");
+        fprint_json_string(f, d->file, strlen(d->file));
+        fprintf(f, ", \"line\": %d, \"column\": %d, \"severity\": \"%s\", \"message\": ", d->line, d->column,
+                d->severity);
+        fprint_json_string(f, d->message, strlen(d->message));
+        fprintf(f, "}");
+    }
+    fprintf(f, "%s],\n", num_compiler_diagnostics ? "\n  " : "");
+    if (compiler_diagnostics_dropped > 0) {
+        fprintf(f, "  \"compiler_diagnostics_dropped\": %d,\n", compiler_diagnostics_dropped);
+    }
+    fprintf(f, "  \"compile_manifest\": {\"profile\": \"%s\", \"profile_flags\": \"%s\", \"preprocess_ms\": %ld, "
+               "\"variants\": [", compile_profile->name, compile_profile->flags, preprocess_ms);
+    for (int v = 0; v < num_compile_variants; v++) {
+        fprintf(f, "%s{\"name\": \"%s\", \"flags\": \"%s\", \"built\": %s, \"result\": \"%s\", \"pch\": %s, "
+                   "\"compile_ms\": %ld}",
+                v ? ", " : "", compile_variants[v].spec->name, compile_variants[v].spec->flags,
+                compile_variants[v].ok ? "true" : "false", compile_result_names[compile_variants[v].result],
+                compile_variants[v].used_pch ? "true" : "false", compile_variants[v].compile_ms);
+    }
+    fprintf(f, "]},\n");
+    if (grade_store_dir[0] != '\0') fprintf(f, "  \"stored_results\": %d,\n", metrics->stored_results);
+    fprintf(f, "  \"verdicts\": {");
+    for (int v = 0; v < VERDICT_COUNT; v++) {
+        fprintf(f, "%s\"%s\": %d", v ? ", " : "", verdict_names[v], metrics->verdict_counts[v]);
+    }
+    fprintf(f, "},\n");
+    if (suite->interactor_source[0] != '\0') {
+        fprintf(f, "  \"interaction\": {\"queries\": %ld, \"round_trips\": %ld, "
+                   "\"mean_latency_ms\": %.3f, \"max_latency_ms\": %.3f},\n",
+                metrics->interaction_queries, metrics->interaction_round_trips,
+                metrics->interaction_round_trips > 0
+                    ? metrics->interaction_latency_ms / metrics->interaction_round_trips : 0.0,
+                metrics->interaction_max_latency_ms);
+    }
+    fprintf(f, "  \"output_limit_exceeded\": %d,\n", metrics->output_limit_exceeded);
     
     // Include failed test details
     fprintf(f, "  \"failed_test_details\": [\n");
     for (int i = 0; i < metrics->num_failed_details; i++) {
-        fprintf(f, "    \"%s\"", metrics->failed_tests[i]);
+        fprintf(f, "    ");
+        fprint_json_string(f, metrics->failed_tests[i], strlen(metrics->failed_tests[i]));
         if (i < metrics->num_failed_details - 1) fprintf(f, ",");
         fprintf(f, "\n");
     }
     fprintf(f, "  ],\n");
+
+    // Line diffs of wrong answers, for the judge's failure analysis
+    fprintf(f, "  \"failed_test_diffs\": [\n");
+    for (int i = 0; i < metrics->num_failed_diffs; i++) {
+        fprintf(f, "    %s%s\n", metrics->failed_diffs[i], i < metrics->num_failed_diffs - 1 ? "," : "");
+    }
+    fprintf(f, "  ],\n");
+
+    // Per-test outcomes, used by `merge` to combine shards
+    fprintf(f, "  \"test_results\": [\n");
+    int written = 0;
+    for (int i = 0; test_outcomes && i < suite->num_tests; i++) {
+        if (!test_outcomes[i].selected) continue;
+        fprintf(f, "%s    {\"test\": %d, \"passed\": %s, \"verdict\": \"%s\", \"weight\": %g",
+                written ? ",\n" : "", i + 1, test_outcomes[i].passed ? "true" : "false",
+                verdict_names[test_outcomes[i].verdict], suite->tests[i].weight);
+        if (suite->checker_source[0] != '\0' || suite->interactor_source[0] != '\0') {
+            fprintf(f, ", \"score\": %g", test_outcomes[i].score);
+        }
+        if (suite->interactor_source[0] != '\0') {
+            fprintf(f, ", \"queries\": %ld, \"round_trips\": %ld, \"mean_latency_ms\": %.3f, "
+                       "\"max_latency_ms\": %.3f", test_outcomes[i].queries, test_outcomes[i].round_trips,
+                    test_outcomes[i].mean_latency_ms, test_outcomes[i].max_latency_ms);
+        }
+        if (test_outcomes[i].output_limit_exceeded) {
+            fprintf(f, ", \"output_limit_exceeded\": true, \"output_bytes\": %ld", test_outcomes[i].output_bytes);
+        }
+        fprintf(f, "}");
+        written++;
+    }
+    fprintf(f, "%s  ],\n", written ? "\n" : "");
     
     // Include potential edge cases for further analysis
     fprintf(f, "  \"potential_edge_cases\": [\n");
-    for (int i = 0; i < test_suite.num_edge_cases; i++) {
-        fprintf(f, "    \"%s\"", test_suite.potential_edge_cases[i]);
-        if (i < test_suite.num_edge_cases - 1) fprintf(f, ",");
+    for (int i = 0; i < suite->num_edge_cases; i++) {
+        fprintf(f, "    ");
+        fprint_json_string(f, suite->potential_edge_cases[i], strlen(suite->potential_edge_cases[i]));
+        if (i < suite->num_edge_cases - 1) fprintf(f, ",");
         fprintf(f, "\n");
     }
     fprintf(f, "  ]\n");
@@ -319,64 +1357,263 @@ void write_enhanced_results_to_json(const EnhancedEvalMetrics *metrics) {
 // --- Main Logic (Modified) ---
 
 int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <source.c> <test_cases.json>\n", argv[0]);
+    select_byte_kernels();
+    if (argc >= 2 && strcmp(argv[1], "bench-kernels") == 0) {
+        long max_size = (argc >= 3) ? atol(argv[2]) : (16L << 20);
+        return benchmark_byte_kernels(max_size < 4096 ? 4096 : max_size) == 0 ? 0 : 1;
+    }
+    if (argc >= 2 && strcmp(argv[1], "self-check") == 0) {
+        return run_self_checks() == 0 ? 0 : 1;
+    }
+    if (argc >= 2 && strcmp(argv[1], "merge") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s merge <merged.json> <partial.json>...\n", argv[0]);
+            return 1;
+        }
+        return merge_partial_results(argv[2], argc - 3, argv + 3) == 0 ? 0 : 1;
+    }
+    if (argc >= 2 && strcmp(argv[1], "batch") == 0) {
+        // Everything after "--" is passed to each evaluation
+        int end = 2;
+        while (end < argc && strcmp(argv[end], "--") != 0) end++;
+        if (end < 5) {
+            fprintf(stderr, "Usage: %s batch <test_cases.json> <results_dir> <source.c>... [-- options]\n", argv[0]);
+            return 1;
+        }
+        int num_options = end < argc ? argc - end - 1 : 0;
+        return run_batch(argv[2], argv[3], end - 4, argv + 4, num_options, argv + end + 1) == 0 ? 0 : 1;
+    }
+
+    static struct option long_options[] = {
+        {"memo-dir", required_argument, NULL, 'm'},
+        {"shared-suite", no_argument, NULL, 's'},
+        {"shard", required_argument, NULL, 'S'},
+        {"tests", required_argument, NULL, 't'},
+        {"output", required_argument, NULL, 'o'},
+        {"target-score", required_argument, NULL, 'T'},
+        {"history", required_argument, NULL, 'H'},
+        {"regrade", required_argument, NULL, 'R'},
+        {"variants", required_argument, NULL, 'V'},
+        {"profile", required_argument, NULL, 'P'},
+        {"pch-dir", required_argument, NULL, 'C'},
+        {"pch-includes", required_argument, NULL, 'I'},
+        {"smoke", no_argument, NULL, 'Q'},
+        {"in-memory", no_argument, NULL, 'M'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:sS:t:o:T:H:R:V:P:C:I:QM", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'm':
+            if (strlen(optarg) > MAX_CACHE_DIR_LENGTH) {
+                fprintf(stderr, "❌ --memo-dir path is too long (at most %d characters)\n", MAX_CACHE_DIR_LENGTH);
+                return 1;
+            }
+            snprintf(memo_dir, sizeof(memo_dir), "%s", optarg);
+            if (mkdir(memo_dir, 0700) != 0 && errno != EEXIST) {
+                perror("mkdir (memo dir)");
+                return 1;
+            }
+            break;
+        case 's':
+            use_shared_suite = 1;
+            break;
+        case 'S':
+            if (sscanf(optarg, "%d/%d", &shard_index, &shard_count) != 2 ||
+                shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+                fprintf(stderr, "❌ Invalid --shard '%s' (expected i/N with 1 <= i <= N)\n", optarg);
+                return 1;
+            }
+            break;
+        case 't':
+            test_id_spec = optarg;
+            break;
+        case 'o':
+            snprintf(results_path, sizeof(results_path), "%s", optarg);
+            break;
+        case 'T':
+            target_score = strtof(optarg, NULL);
+            if (target_score < 0 || target_score > 100) {
+                fprintf(stderr, "❌ --target-score must be between 0 and 100\n");
+                return 1;
+            }
+            break;
+        case 'H':
+            snprintf(history_path, sizeof(history_path), "%s", optarg);
+            break;
+        case 'P':
+            profile_option = optarg;
+            break;
+        case 'V':
+            variant_list = optarg;
+            break;
+        case 'C':
+            if (strlen(optarg) > MAX_CACHE_DIR_LENGTH) {
+                fprintf(stderr, "❌ --pch-dir path is too long (at most %d characters)\n", MAX_CACHE_DIR_LENGTH);
+                return 1;
+            }
+            snprintf(pch_dir, sizeof(pch_dir), "%s", optarg);
+            if (mkdir(pch_dir, 0700) != 0 && errno != EEXIST) {
+                perror("mkdir (pch dir)");
+                return 1;
+            }
+            break;
+        case 'I':
+            pch_include_list = optarg;
+            break;
+        case 'Q':
+            smoke_run = 1;
+            break;
+        case 'M':
+            in_memory = 1;
+            break;
+        case 'R':
+            if (strlen(optarg) > MAX_CACHE_DIR_LENGTH) {
+                fprintf(stderr, "❌ --regrade path is too long (at most %d characters)\n", MAX_CACHE_DIR_LENGTH);
+                return 1;
+            }
+            snprintf(grade_store_dir, sizeof(grade_store_dir), "%s", optarg);
+            if (mkdir(grade_store_dir, 0700) != 0 && errno != EEXIST) {
+                perror("mkdir (grade store)");
+                return 1;
+            }
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2) {
+        fprintf(stderr, "Usage: %s [--memo-dir DIR] [--shared-suite] [--shard i/N] [--tests LIST]\n"
+                        "          [--output PATH] [--target-score PCT] [--history FILE] [--regrade DIR]\n"
+                        "          [--variants plain,asan,gcov,pg] [--profile auto|fast-compile|balanced|release|measure]\n"
+                        "          [--pch-dir DIR] [--pch-includes stdio.h,stdlib.h,...] [--smoke]\n"
+                        "          [--in-memory]\n"
+                        "          <source.c> <test_cases.json>\n"
+                        "       %s merge <merged.json> <partial.json>...\n"
+                        "       %s batch <test_cases.json> <results_dir> <source.c>... [-- options]\n"
+                        "       %s bench-kernels [max_output_bytes]\n"
+                        "       %s self-check\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
+    if (smoke_run && grade_store_dir[0]) {
+        // Smoke builds are not the graded binary, so their outcomes must not be stored as grades
+        fprintf(stderr, "❌ --smoke cannot be combined with --regrade\n");
+        return 1;
+    }
+    const char *source_file = argv[optind];
+    const char *tests_file = argv[optind + 1];
 
     // Set up signal handlers and cleanup routine
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN); // Children closing their stdin must not kill the evaluator
     atexit(cleanup);
 
     // Load LLM-generated test cases
     printf("🔍 Loading LLM-generated test cases...\n");
-    if (load_test_cases_from_json(argv[2]) != 0) {
-        fprintf(stderr, "❌ Failed to load test cases from %s\n", argv[2]);
+    if (load_test_suite(tests_file) != 0) {
+        fprintf(stderr, "❌ Failed to load test cases from %s\n", tests_file);
         return 1;
     }
     
     print_test_suite_info();
+    if (plan_compile_variants(variant_list ? variant_list : suite->compile_variants) != 0) return 1;
+    if (select_compile_profile(profile_option ? profile_option : suite->compile_profile) != 0) return 1;
+
+    EnhancedEvalMetrics metrics = {0};
+    metrics.tests_run = select_tests();
+    if (metrics.tests_run < 0) return 1;
+    if (history_path[0]) load_test_history();
 
     // Create secure temporary directory
-    char temp_dir_template[] = "/tmp/safe_eval_XXXXXX";
-    if (mkdtemp(temp_dir_template) == NULL) {
+    snprintf(temp_dir_path, sizeof(temp_dir_path), "%s/safe_eval_XXXXXX",
+             in_memory ? IN_MEMORY_TEMP_DIR : "/tmp");
+    if (mkdtemp(temp_dir_path) == NULL) {
         perror("mkdtemp failed");
+        temp_dir_path[0] = '\0';
         return 1;
     }
-    snprintf(temp_dir_path, sizeof(temp_dir_path), "%s", temp_dir_template);
+    if (in_memory) {
+        // Every kept spool holds a descriptor, so allow as many as the hard limit does
+        struct rlimit fd_limit;
+        if (getrlimit(RLIMIT_NOFILE, &fd_limit) == 0) {
+            fd_limit.rlim_cur = fd_limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &fd_limit);
+        }
+        int log_fd = create_data_memfd("memory-log", "", 0);
+        if (log_fd >= 0) memfd_path(log_fd, memory_log_path, sizeof(memory_log_path));
+    }
 
     long start_time = current_time_ms();
 
-    printf("1. Compiling source file: %s\n", argv[1]);
-    if (compile_source(argv[1]) != 0) {
-        fprintf(stderr, "❌ Compilation failed.\n");
-        EnhancedEvalMetrics metrics = {0};
+    // With --regrade, only tests whose definition or binary changed still need the program
+    int run_quality_checks = !(shard_count > 0 && shard_index != 1);
+    int tests_to_run = grade_store_dir[0] ? mark_stored_tests(source_file) : metrics.tests_run;
+    int quality_from_store = run_quality_checks && grade_store_dir[0] && stored_quality_valid;
+
+    printf("1. Compiling source file: %s\n", source_file);
+    if (tests_to_run == 0 && (!run_quality_checks || quality_from_store)) {
+        printf("    ♻️  Every result is in the grade store; nothing to compile.\n\n");
+    } else if ((smoke_run ? compile_source_smoke(source_file) : compile_source(source_file)) != 0) {
+        fprintf(stderr, "❌ Compilation failed (%s).\n", compile_result_names[compile_result]);
         write_enhanced_results_to_json(&metrics);
         return 1;
+    } else {
+        printf("    ✅ Compilation successful (preprocessed in %ld ms).\n", preprocess_ms);
+        int warnings = count_compiler_diagnostics("warning");
+        if (warnings > 0) printf("    ⚠️  %d compiler warning(s), listed in the results\n", warnings);
+        for (int v = 0; v < num_compile_variants; v++) {
+            printf("      %s %-6s %ld ms%s\n", compile_variants[v].ok ? "✅" : "⚠️ ",
+                   compile_variants[v].spec->name, compile_variants[v].compile_ms,
+                   compile_variants[v].used_pch ? " (precompiled header)" : "");
+        }
+        printf("\n");
+        if (in_memory && load_executables_into_memfds() != 0) {
+            fprintf(stderr, "❌ Could not move the program into memory.\n");
+            return 1;
+        }
+        executable_hash = hash_file_contents(executable_path);
     }
-    printf("    ✅ Compilation successful.\n\n");
-
-    EnhancedEvalMetrics metrics = {0};
     
     printf("2. Running LLM-generated correctness tests...\n");
     metrics.passrate = calculate_dynamic_passrate(&metrics);
     printf("    ✅ Simple Passrate: %.1f%% (%d/%d tests passed)\n", 
-           metrics.passrate, metrics.tests_passed, test_suite.num_tests);
-    printf("    ✅ Weighted Score: %.1f%%\n\n", metrics.weighted_score);
+           metrics.passrate, metrics.tests_passed, metrics.tests_run);
+    printf("    ✅ Weighted Score: %.1f%%\n", metrics.weighted_score);
+    if (metrics.reused_results > 0) {
+        printf("    ♻️  %d test(s) answered from memoized runs\n", metrics.reused_results);
+    }
+    printf("\n");
 
-    printf("3. Analyzing memory usage with Valgrind...\n");
-    metrics.memory_score = analyze_memory();
-    printf("    ✅ Memory Score: %.1f\n\n", metrics.memory_score);
+    // Whole-program checks run once per suite: in shard 1 when sharding
+    if (!run_quality_checks) {
+        metrics.quality_checks_skipped = 1;
+        printf("3-4. Memory and robustness checks run in shard 1/%d\n\n", shard_count);
+    } else if (smoke_run) {
+        metrics.quality_checks_skipped = 1;
+        printf("3-4. Smoke run: memory and robustness checks wait for the gcc build\n\n");
+    } else if (quality_from_store) {
+        metrics.memory_score = stored_memory_score;
+        metrics.robustness_score = stored_robustness_score;
+        printf("3-4. Memory and robustness scores unchanged since the stored grade: %.1f / %.1f\n\n",
+               metrics.memory_score, metrics.robustness_score);
+    } else {
+        printf("3. Analyzing memory usage with %s...\n", variant_executable("asan") ? "AddressSanitizer" : "Valgrind");
+        metrics.memory_score = analyze_memory();
+        printf("    ✅ Memory Score: %.1f\n\n", metrics.memory_score);
 
-    printf("4. Checking robustness...\n");
-    metrics.robustness_score = check_robustness();
-    printf("    ✅ Robustness Score: %.1f\n\n", metrics.robustness_score);
+        printf("4. Checking robustness...\n");
+        metrics.robustness_score = check_robustness();
+        printf("    ✅ Robustness Score: %.1f\n\n", metrics.robustness_score);
+    }
 
     metrics.execution_time_ms = current_time_ms() - start_time;
+    if (grade_store_dir[0]) save_stored_grades(&metrics);
 
     write_enhanced_results_to_json(&metrics);
-    printf("🎉 Enhanced evaluation complete. Results written to %s\n", RESULTS_JSON_PATH);
+    printf("🎉 Enhanced evaluation complete. Results written to %s\n", results_path);
     printf("📊 Ready for Stage 3 analysis...\n");
 
     return 0;
@@ -388,25 +1625,336 @@ int main(int argc, char **argv) {
  * @brief Cleans up temporary files and directories.
  */
 void cleanup(void) {
-    if (strlen(temp_dir_path) > 0) {
-        char command[512];
-        snprintf(command, sizeof(command), "rm -rf %s", temp_dir_path);
-        system(command);
+    for (int i = 0; i < num_pending_checks; i++) {
+        kill(-pending_checks[i].pid, SIGKILL);
+        close(pending_checks[i].output_fd);
     }
+    // Compilers run in their own process groups, so a Ctrl-C no longer reaches them
+    if (compiler_pid > 0) kill(-compiler_pid, SIGKILL);
+    for (int v = 0; v < num_compile_variants; v++) {
+        if (compile_variants[v].pid > 0) kill(-compile_variants[v].pid, SIGKILL);
+    }
+    if (strlen(temp_dir_path) > 0) remove_tree(temp_dir_path);
+    if (aborted_run.output_path[0] != '\0') remove_spool(aborted_run.output_path);
     remove(RESULTS_JSON_PATH);
     remove(VALGRIND_LOG_PATH);
 }
 
 /**
- * @brief Handles termination signals to ensure cleanup is called.
+ * @brief Starts a command with only the program name in it.
  */
-void handle_signal(int sig) {
-    printf("\nCaught signal %d, cleaning up and exiting.\n", sig);
-    exit(1); // atexit will call cleanup
+void command_init(Command *cmd, const char *program) {
+    cmd->argc = 0;
+    cmd->used = 0;
+    cmd->compiler = 0;
+    cmd->report_diagnostics = 0;
+    cmd->argv[0] = NULL;
+    command_add(cmd, program);
 }
 
 /**
- * @brief Gets the current time in milliseconds.
+ * @brief Starts a compiler command, which runs in its own process group under the COMPILE_* limits.
+ */
+void command_init_compiler(Command *cmd, const char *program) {
+    command_init(cmd, program);
+    cmd->compiler = 1;
+}
+
+/**
+ * @brief Appends one argument verbatim; spaces and quotes in it stay part of the argument.
+ *        Arguments past MAX_COMMAND_ARGS or COMMAND_STORAGE_SIZE are dropped.
+ */
+void command_add(Command *cmd, const char *arg) {
+    size_t len = strlen(arg) + 1;
+    if (cmd->argc >= MAX_COMMAND_ARGS || cmd->used + len > sizeof(cmd->storage)) {
+        fprintf(stderr, "⚠️  Command too long, dropping argument '%s'\n", arg);
+        return;
+    }
+    cmd->argv[cmd->argc] = memcpy(cmd->storage + cmd->used, arg, len);
+    cmd->used += len;
+    cmd->argv[++cmd->argc] = NULL;
+}
+
+/**
+ * @brief Appends a whitespace-separated flag list (a profile's or variant's flags) word by word.
+ */
+void command_add_words(Command *cmd, const char *words) {
+    char copy[512];
+    snprintf(copy, sizeof(copy), "%s", words);
+    char *save;
+    for (char *word = strtok_r(copy, " \t", &save); word; word = strtok_r(NULL, " \t", &save)) {
+        command_add(cmd, word);
+    }
+}
+
+/**
+ * @brief Forks and execs a command, looking the program up in PATH.
+ * @param stdin_fd, stdout_fd, stderr_fd Descriptors for the child, or -1 to inherit the evaluator's.
+ * @param env One extra "NAME=value" for the child's environment, or NULL.
+ * @return The child's pid, or -1 if fork failed. A failed exec exits with EXEC_FAILURE_EXIT_CODE,
+ *         as the shell did for a missing command.
+ */
+pid_t spawn_command(const Command *cmd, int stdin_fd, int stdout_fd, int stderr_fd, const char *env) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (cmd->compiler) {
+            setpgid(0, 0);
+            set_compiler_resource_limits();
+        }
+        if (stdin_fd >= 0) dup2(stdin_fd, STDIN_FILENO);
+        if (stdout_fd >= 0) dup2(stdout_fd, STDOUT_FILENO);
+        if (stderr_fd >= 0) dup2(stderr_fd, STDERR_FILENO);
+        if (env) putenv((char *)env);
+        execvp(cmd->argv[0], cmd->argv);
+        _exit(EXEC_FAILURE_EXIT_CODE);
+    }
+    if (pid == -1) perror("fork failed");
+    if (pid > 0 && cmd->compiler) setpgid(pid, pid); // Also here, so a kill right after fork hits the group
+    return pid;
+}
+
+/**
+ * @brief Runs a command to completion, feeding it input through a pipe.
+ * @param input Written to the child's stdin, which is then closed; NULL inherits stdin.
+ * @return The wait status, as system() would return it, or -1 if the child could not be started.
+ */
+int run_command(const Command *cmd, const char *input, int stdout_fd, int stderr_fd, const char *env) {
+    int pipe_fds[2] = {-1, -1};
+    if (input && pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        perror("pipe2 failed");
+        return -1;
+    }
+    pid_t pid = spawn_command(cmd, pipe_fds[0], stdout_fd, stderr_fd, env);
+    if (input) {
+        close(pipe_fds[0]);
+        // SIGPIPE is ignored, so a child that exits without reading just ends the write
+        size_t len = strlen(input), written = 0;
+        while (pid > 0 && written < len) {
+            ssize_t n = write(pipe_fds[1], input + written, len - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += (size_t)n;
+        }
+        close(pipe_fds[1]);
+    }
+    if (pid == -1) return -1;
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return status;
+}
+
+/**
+ * @brief Runs a compiler command under the compile limits, echoing its diagnostics to stderr.
+ *
+ * The compiler and everything it starts (cc1, as, ld) share a process group, so a wall
+ * timeout kills the whole pipeline rather than just the driver.
+ * @param result Receives how the compile ended.
+ * @return The wait status, or -1 if the compiler could not be started.
+ */
+int run_compiler(const Command *cmd, int stdout_fd, CompileResult *result) {
+    *result = COMPILE_ERROR;
+    int diagnostics_fd = create_data_memfd("compiler-diagnostics", "", 0);
+    compiler_pid = spawn_command(cmd, -1, stdout_fd, diagnostics_fd, NULL);
+    if (compiler_pid == -1) {
+        compiler_pid = 0;
+        if (diagnostics_fd >= 0) close(diagnostics_fd);
+        return -1;
+    }
+
+    long deadline = current_time_ms() + COMPILE_WALL_LIMIT_MS;
+    int status = 0, timed_out = 0;
+    for (;;) {
+        pid_t done = waitpid(compiler_pid, &status, WNOHANG);
+        if (done == compiler_pid || (done == -1 && errno != EINTR)) break;
+        if (!timed_out && current_time_ms() >= deadline) {
+            kill(-compiler_pid, SIGKILL);
+            timed_out = 1;
+        }
+        usleep(1000);
+    }
+    kill(-compiler_pid, SIGKILL); // Anything the driver left behind
+    compiler_pid = 0;
+    *result = finish_compile(status, timed_out, diagnostics_fd, cmd->report_diagnostics);
+    return status;
+}
+
+/**
+ * @brief Echoes a finished compiler's diagnostics and tells resource failures apart from errors.
+ *
+ * The compiler reports most limit hits itself (cc1 "out of memory", the driver's "CPU time
+ * limit exceeded signal terminated program cc1"), so the diagnostics are searched for them.
+ * Only our own wall deadline (timed_out) or SIGXCPU is a timeout. With report set the
+ * diagnostics are also parsed into compiler_diagnostics. Closes diagnostics_fd.
+ */
+CompileResult finish_compile(int status, int timed_out, int diagnostics_fd, int report) {
+    CompileResult result = COMPILE_ERROR;
+    if (diagnostics_fd >= 0) {
+        char buffer[4096];
+        ssize_t n;
+        off_t offset = 0;
+        while ((n = pread(diagnostics_fd, buffer, sizeof(buffer) - 1, offset)) > 0) {
+            fwrite(buffer, 1, (size_t)n, stderr);
+            offset += n;
+            buffer[n] = '\0';
+            if (strstr(buffer, "out of memory") || strstr(buffer, "virtual memory exhausted") ||
+                strstr(buffer, "Cannot allocate memory")) {
+                result = COMPILE_OOM;
+            } else if (strstr(buffer, "CPU time limit exceeded") && result == COMPILE_ERROR) {
+                result = COMPILE_TIMEOUT;
+            } else if (strstr(buffer, "File size limit exceeded") && result == COMPILE_ERROR) {
+                result = COMPILE_OUTPUT_LIMIT;
+            }
+        }
+        if (report && offset > 0) {
+            size_t len = offset < DIAGNOSTICS_PARSE_LIMIT ? (size_t)offset : DIAGNOSTICS_PARSE_LIMIT;
+            char *text = malloc(len);
+            if (text && pread(diagnostics_fd, text, len, 0) == (ssize_t)len) record_compiler_diagnostics(text, len);
+            free(text);
+        }
+        close(diagnostics_fd);
+    }
+
+    if (timed_out) return COMPILE_TIMEOUT;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return COMPILE_OK;
+    if (WIFSIGNALED(status)) {
+        if (WTERMSIG(status) == SIGXCPU) return COMPILE_TIMEOUT;
+        if (WTERMSIG(status) == SIGXFSZ) return COMPILE_OUTPUT_LIMIT;
+    }
+    // Any other kill (the OOM killer, typically) is judged by the diagnostics like an error exit
+    return result;
+}
+
+/**
+ * @brief Parses one line of compiler output into a diagnostic.
+ *
+ * Understands "file:line:col: severity: message" (gcc, with or without the column as tcc
+ * prints it), "tool: severity: message" from the driver, and the linker's
+ * "file:(.text+0x1e): undefined reference to `f'". Caret and context lines do not match.
+ * @return 1 if the line is a diagnostic, 0 otherwise.
+ */
+int parse_compiler_diagnostic(const char *line, CompilerDiagnostic *diag) {
+    static const char *severities[] = {"fatal error", "error", "warning", "note"};
+    const char *sep = NULL, *severity = NULL;
+    for (size_t k = 0; k < sizeof(severities) / sizeof(severities[0]); k++) {
+        char pattern[32];
+        snprintf(pattern, sizeof(pattern), ": %s: ", severities[k]);
+        const char *found = strstr(line, pattern);
+        if (found && (!sep || found < sep)) {
+            sep = found;
+            severity = severities[k];
+        }
+    }
+
+    memset(diag, 0, sizeof(*diag));
+    size_t prefix_len;
+    if (sep) {
+        snprintf(diag->severity, sizeof(diag->severity), "%s", severity);
+        snprintf(diag->message, sizeof(diag->message), "%s", sep + strlen(severity) + 4);
+        prefix_len = sep - line;
+    } else {
+        const char *found = strstr(line, ": undefined reference to ");
+        if (!found) return 0;
+        snprintf(diag->severity, sizeof(diag->severity), "error");
+        snprintf(diag->message, sizeof(diag->message), "%s", found + 2);
+        prefix_len = found - line;
+        const char *section = strstr(line, ":(");
+        if (section && section < found) prefix_len = section - line;
+        // Newer linkers put their own name first ("/usr/bin/ld: main.c:(.text+0x1e): ...")
+        for (size_t k = prefix_len; k > 1; k--) {
+            if (line[k - 2] == ':' && line[k - 1] == ' ') {
+                line += k;
+                prefix_len -= k;
+                break;
+            }
+        }
+    }
+    // Peel ":line" and ":col" off the end of the location
+    for (int field = 0; field < 2; field++) {
+        size_t k = prefix_len;
+        while (k > 0 && isdigit((unsigned char)line[k - 1])) k--;
+        if (k == prefix_len || k == 0 || line[k - 1] != ':') break;
+        diag->column = diag->line;
+        diag->line = atoi(line + k);
+        prefix_len = k - 1;
+    }
+    if (prefix_len >= sizeof(diag->file)) prefix_len = sizeof(diag->file) - 1;
+    memcpy(diag->file, line, prefix_len);
+    diag->file[prefix_len] = '\0';
+    size_t msg_len = strlen(diag->message);
+    while (msg_len > 0 && IS_SPACE_BYTE(diag->message[msg_len - 1])) diag->message[--msg_len] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Adds the diagnostics in a compiler's output to compiler_diagnostics, skipping ones
+ *        already recorded (each variant reports the same warnings).
+ */
+void record_compiler_diagnostics(const char *text, size_t len) {
+    const char *end = text + len;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', end - text);
+        size_t line_len = newline ? (size_t)(newline - text) : (size_t)(end - text);
+        char line[1024];
+        snprintf(line, sizeof(line), "%.*s", (int)(line_len < sizeof(line) ? line_len : sizeof(line) - 1), text);
+        text += line_len + 1;
+
+        CompilerDiagnostic diag;
+        if (!parse_compiler_diagnostic(line, &diag)) continue;
+        int known = 0;
+        for (int i = 0; i < num_compiler_diagnostics && !known; i++) {
+            const CompilerDiagnostic *d = &compiler_diagnostics[i];
+            known = d->line == diag.line && d->column == diag.column && strcmp(d->file, diag.file) == 0 &&
+                    strcmp(d->severity, diag.severity) == 0 && strcmp(d->message, diag.message) == 0;
+        }
+        if (known) continue;
+        if (num_compiler_diagnostics < MAX_COMPILER_DIAGNOSTICS) {
+            compiler_diagnostics[num_compiler_diagnostics++] = diag;
+        } else {
+            compiler_diagnostics_dropped++;
+        }
+    }
+}
+
+/**
+ * @brief Counts recorded diagnostics of one severity.
+ */
+int count_compiler_diagnostics(const char *severity) {
+    int count = 0;
+    for (int i = 0; i < num_compiler_diagnostics; i++) {
+        count += strcmp(compiler_diagnostics[i].severity, severity) == 0;
+    }
+    return count;
+}
+
+int remove_tree_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0; // Keep going past entries that cannot be removed
+}
+
+/**
+ * @brief Removes a directory tree, children first, without following symlinks.
+ * @return 0 on success, -1 if the walk failed.
+ */
+int remove_tree(const char *path) {
+    return nftw(path, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/**
+ * @brief Handles termination signals to ensure cleanup is called.
+ */
+void handle_signal(int sig) {
+    printf("\nCaught signal %d, cleaning up and exiting.\n", sig);
+    exit(1); // atexit will call cleanup
+}
+
+/**
+ * @brief Gets the current time in milliseconds.
  */
 long current_time_ms(void) {
     struct timeval tv;
@@ -414,6 +1962,15 @@ long current_time_ms(void) {
     return (long)(tv.tv_sec) * 1000 + (long)(tv.tv_usec) / 1000;
 }
 
+/**
+ * @brief Gets the current monotonic time in microseconds, for interaction latencies.
+ */
+long current_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /**
  * @brief Sets resource limits for the child process.
  */
@@ -425,113 +1982,666 @@ void set_child_resource_limits(void) {
         perror("setrlimit(RLIMIT_AS) failed");
     }
 
+    // SIGXCPU at the limit tells a CPU timeout apart; SIGKILL a second later if it is ignored
     struct rlimit cpu_limit;
     cpu_limit.rlim_cur = CPU_TIME_LIMIT_S;
-    cpu_limit.rlim_max = CPU_TIME_LIMIT_S;
+    cpu_limit.rlim_max = CPU_TIME_LIMIT_S + 1;
     if (setrlimit(RLIMIT_CPU, &cpu_limit) != 0) {
         perror("setrlimit(RLIMIT_CPU) failed");
     }
 }
 
 /**
- * @brief Compiles the given C source file into the temp directory.
+ * @brief Applies the compile limits in a compiler child: memory, CPU and largest file written.
+ *
+ * Inherited by cc1, as and ld, so each of them is bounded on its own.
+ */
+void set_compiler_resource_limits(void) {
+    struct rlimit mem_limit = {COMPILE_MEMORY_LIMIT_MB * 1024L * 1024L, COMPILE_MEMORY_LIMIT_MB * 1024L * 1024L};
+    if (setrlimit(RLIMIT_AS, &mem_limit) != 0) perror("setrlimit(RLIMIT_AS) failed");
+
+    struct rlimit cpu_limit = {COMPILE_CPU_LIMIT_S, COMPILE_CPU_LIMIT_S + 1};
+    if (setrlimit(RLIMIT_CPU, &cpu_limit) != 0) perror("setrlimit(RLIMIT_CPU) failed");
+
+    struct rlimit file_limit = {COMPILE_OUTPUT_LIMIT_MB * 1024L * 1024L, COMPILE_OUTPUT_LIMIT_MB * 1024L * 1024L};
+    if (setrlimit(RLIMIT_FSIZE, &file_limit) != 0) perror("setrlimit(RLIMIT_FSIZE) failed");
+}
+
+/**
+ * @brief Compiles the given C source file into the temp directory, with every planned variant.
+ *
+ * The source is preprocessed once; each variant then compiles the .i concurrently, so the
+ * total is about the slowest variant. Only the plain build has to succeed: a variant that
+ * fails (a missing sanitizer runtime, say) is just marked unbuilt in the manifest.
+ *
+ * With --pch-dir, an eligible source is compiled as-is with the cached precompiled header
+ * forced in instead (a .gch cannot apply to already-preprocessed input); any variant that
+ * fails that way is retried from the .i.
  * @return 0 on success, -1 on failure.
  */
 int compile_source(const char *source_filename) {
     snprintf(executable_path, sizeof(executable_path), "%s/user_program", temp_dir_path);
-    
-    char command[1024];
-    snprintf(command, sizeof(command), "gcc -o %s %s -lm", executable_path, source_filename);
 
-    int ret = system(command);
-    return (WIFEXITED(ret) && WEXITSTATUS(ret) == 0) ? 0 : -1;
+    char preprocessed[MAX_PATH_SIZE];
+    snprintf(preprocessed, sizeof(preprocessed), "%s/user_program.i", temp_dir_path);
+    num_compiler_diagnostics = 0;
+    compiler_diagnostics_dropped = 0;
+    Command command;
+    command_init_compiler(&command, USER_COMPILER);
+    command.report_diagnostics = 1;
+    command_add_words(&command, compile_profile->flags); // They set macros such as __OPTIMIZE__
+    command_add(&command, "-E");
+    command_add(&command, "-o");
+    command_add(&command, preprocessed);
+    command_add(&command, source_filename);
+
+    long start = current_time_ms();
+    run_compiler(&command, -1, &compile_result);
+    preprocess_ms = current_time_ms() - start;
+    if (compile_result != COMPILE_OK) return -1;
+
+    pch_headers[0] = '\0';
+    if (pch_dir[0] != '\0' && pch_eligible_headers(source_filename, pch_headers, sizeof(pch_headers)) < 0) {
+        printf("    ⚠️  Include order not safe for the precompiled header; compiling normally.\n");
+    }
+
+    start = current_time_ms();
+    for (int v = 0; v < num_compile_variants; v++) {
+        CompileVariant *variant = &compile_variants[v];
+        if (v == 0) {
+            snprintf(variant->path, sizeof(variant->path), "%s", executable_path);
+        } else {
+            snprintf(variant->path, sizeof(variant->path), "%s/user_program_%s", temp_dir_path, variant->spec->name);
+        }
+        char header[MAX_PATH_SIZE];
+        variant->used_pch = pch_headers[0] != '\0' && ensure_precompiled_header(variant, header, sizeof(header)) == 0;
+        if (variant->used_pch) {
+            build_compile_command(&command, variant, header, source_filename);
+        } else {
+            build_compile_command(&command, variant, NULL, preprocessed);
+        }
+        variant->diagnostics_fd = create_data_memfd("compiler-diagnostics", "", 0);
+        variant->pid = spawn_command(&command, -1, -1, variant->diagnostics_fd, NULL);
+    }
+    wait_for_variant_compiles(start);
+
+    // Fall back to the plain .i build wherever the forced header broke the compile
+    int retried = 0;
+    for (int v = 0; v < num_compile_variants; v++) {
+        CompileVariant *variant = &compile_variants[v];
+        if (variant->ok || !variant->used_pch) continue;
+        variant->used_pch = 0;
+        build_compile_command(&command, variant, NULL, preprocessed);
+        variant->diagnostics_fd = create_data_memfd("compiler-diagnostics", "", 0);
+        variant->pid = spawn_command(&command, -1, -1, variant->diagnostics_fd, NULL);
+        retried++;
+    }
+    if (retried > 0) wait_for_variant_compiles(start);
+    compile_result = compile_variants[0].result;
+    return compile_variants[0].ok ? 0 : -1;
+}
+
+/**
+ * @brief Sets up the compiler command for one variant of the program.
+ * @param forced_header Header for -include (the cached precompiled header), or NULL.
+ * @param input The source, or the preprocessed .i when no header is forced.
+ */
+void build_compile_command(Command *cmd, const CompileVariant *variant, const char *forced_header,
+                           const char *input) {
+    command_init_compiler(cmd, USER_COMPILER);
+    cmd->report_diagnostics = 1;
+    command_add_words(cmd, USER_WARNING_FLAGS);
+    command_add_words(cmd, compile_profile->flags);
+    command_add_words(cmd, variant->spec->flags);
+    if (forced_header) {
+        command_add(cmd, "-include");
+        command_add(cmd, forced_header);
+    }
+    command_add(cmd, "-o");
+    command_add(cmd, variant->path);
+    command_add(cmd, input);
+    command_add_words(cmd, USER_LINK_FLAGS);
+}
+
+/**
+ * @brief Builds the smoke-run binary with tcc, which compiles in milliseconds instead of gcc's ~100.
+ *
+ * The result takes the plain variant's place, so judging does not care which compiler made it;
+ * compiler diagnostics go to stderr exactly as on the gcc path. When tcc is not installed the
+ * build falls back to gcc at -O0, the next cheapest option.
+ * @return 0 on success, -1 on failure.
+ */
+int compile_source_smoke(const char *source_filename) {
+    snprintf(executable_path, sizeof(executable_path), "%s/user_program", temp_dir_path);
+    Command command;
+    command_init_compiler(&command, SMOKE_COMPILER);
+    command.report_diagnostics = 1;
+    command_add(&command, "-o");
+    command_add(&command, executable_path);
+    command_add(&command, source_filename);
+    command_add_words(&command, USER_LINK_FLAGS);
+
+    long start = current_time_ms();
+    int ret = run_compiler(&command, -1, &compile_result);
+    if (WIFEXITED(ret) && WEXITSTATUS(ret) == EXEC_FAILURE_EXIT_CODE) {
+        printf("    ⚠️  tcc is not available; smoke build falls back to gcc -O0.\n");
+        compile_profile = &compile_profiles[0]; // fast-compile
+        num_compile_variants = 1;
+        return compile_source(source_filename);
+    }
+
+    CompileVariant *variant = &compile_variants[0];
+    num_compile_variants = 1;
+    compile_profile = &smoke_profile;
+    variant->spec = &smoke_variant_spec;
+    snprintf(variant->path, sizeof(variant->path), "%s", executable_path);
+    variant->result = compile_result;
+    variant->ok = compile_result == COMPILE_OK;
+    variant->used_pch = 0;
+    variant->compile_ms = current_time_ms() - start;
+    preprocess_ms = 0;
+    return variant->ok ? 0 : -1;
+}
+
+/**
+ * @brief Reaps the variant compilers as they finish, so each variant's own latency is recorded.
+ *        Diagnostics of the optional variants are echoed but not recorded.
+ */
+void wait_for_variant_compiles(long start) {
+    long deadline = current_time_ms() + COMPILE_WALL_LIMIT_MS;
+    int timed_out = 0;
+    for (int v = 0; v < num_compile_variants; v++) {
+        if (compile_variants[v].pid == -1) {
+            compile_variants[v].ok = 0;
+            compile_variants[v].result = COMPILE_ERROR;
+            if (compile_variants[v].diagnostics_fd >= 0) close(compile_variants[v].diagnostics_fd);
+            compile_variants[v].pid = 0;
+        }
+    }
+    int running = num_compile_variants;
+    while (running > 0) {
+        if (!timed_out && current_time_ms() >= deadline) {
+            for (int v = 0; v < num_compile_variants; v++) {
+                if (compile_variants[v].pid > 0) kill(-compile_variants[v].pid, SIGKILL);
+            }
+            timed_out = 1;
+        }
+        for (int v = 0; v < num_compile_variants; v++) {
+            CompileVariant *variant = &compile_variants[v];
+            int status;
+            if (variant->pid <= 0 || waitpid(variant->pid, &status, WNOHANG) != variant->pid) continue;
+            kill(-variant->pid, SIGKILL); // Anything the driver left behind
+            // Only the plain build's diagnostics are the submission's, and not those of a
+            // failed precompiled-header attempt that is about to be retried without it
+            int kept = v == 0 && (!variant->used_pch ||
+                                  (!timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0));
+            variant->result = finish_compile(status, timed_out, variant->diagnostics_fd, kept);
+            variant->ok = variant->result == COMPILE_OK;
+            variant->compile_ms = current_time_ms() - start;
+            variant->pid = 0;
+        }
+        running = 0;
+        for (int v = 0; v < num_compile_variants; v++) running += compile_variants[v].pid > 0;
+        if (running > 0) usleep(1000);
+    }
+}
+
+/**
+ * @brief Builds the compile manifest plan: plain plus the listed variants.
+ * @return 0 on success, -1 on an unknown variant name.
+ */
+int plan_compile_variants(const char *list) {
+    num_compile_variants = 0;
+    compile_variants[num_compile_variants++].spec = &variant_specs[0];
+
+    char names[256];
+    snprintf(names, sizeof(names), "%s", list ? list : "");
+    char *saveptr = NULL;
+    for (char *name = strtok_r(names, ", ", &saveptr); name; name = strtok_r(NULL, ", ", &saveptr)) {
+        const CompileVariantSpec *spec = NULL;
+        for (size_t k = 0; k < sizeof(variant_specs) / sizeof(variant_specs[0]); k++) {
+            if (strcmp(variant_specs[k].name, name) == 0) spec = &variant_specs[k];
+        }
+        if (!spec) {
+            fprintf(stderr, "❌ Unknown compile variant '%s' (known: plain, asan, gcov, pg)\n", name);
+            return -1;
+        }
+
+        int planned = 0;
+        for (int v = 0; v < num_compile_variants; v++) planned |= compile_variants[v].spec == spec;
+        if (!planned && num_compile_variants < MAX_COMPILE_VARIANTS) {
+            compile_variants[num_compile_variants++].spec = spec;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Looks up a successfully built variant in the compile manifest.
+ * @return Its executable, or NULL if it was not planned or failed to build.
+ */
+const char *variant_executable(const char *name) {
+    for (int v = 0; v < num_compile_variants; v++) {
+        if (compile_variants[v].ok && strcmp(compile_variants[v].spec->name, name) == 0) {
+            return compile_variants[v].path;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds which headers of the common-include set the source includes, if forcing them is safe.
+ *
+ * Forcing a header in moves it ahead of everything in the source, so that is only allowed
+ * while every common #include comes before any other directive or code: a #define or #if
+ * in front of it (feature-test macros, NDEBUG) could change what the header declares.
+ * Headers the source does not include are left out, so no extra names become visible.
+ * @return Number of headers written to headers (comma-separated, in set order); 0 when
+ *         none are included, -1 when the include order makes the precompiled header unsafe.
+ */
+int pch_eligible_headers(const char *source_filename, char *headers, size_t headers_size) {
+    char set[256];
+    snprintf(set, sizeof(set), "%s", pch_include_list);
+    char *names[MAX_PCH_INCLUDES];
+    int included[MAX_PCH_INCLUDES] = {0};
+    int num_names = 0;
+    for (char *name = strtok(set, ","); name && num_names < MAX_PCH_INCLUDES; name = strtok(NULL, ",")) {
+        names[num_names++] = name;
+    }
+
+    FILE *f = fopen(source_filename, "r");
+    if (!f) return -1;
+    char line[1024];
+    int in_comment = 0, settled = 0, unsafe = 0;
+    while (!unsafe && fgets(line, sizeof(line), f)) {
+        char *p = line;
+        // Skip leading comments, so only the first real token of the line is looked at
+        for (;;) {
+            while (IS_SPACE_BYTE(*p)) p++;
+            if (in_comment) {
+                char *end = strstr(p, "*/");
+                if (!end) break;
+                p = end + 2;
+                in_comment = 0;
+            } else if (p[0] == '/' && p[1] == '*') {
+                p += 2;
+                in_comment = 1;
+            } else {
+                break;
+            }
+        }
+        if (in_comment || *p == '\0' || (p[0] == '/' && p[1] == '/')) continue;
+        if (*p != '#') {
+            settled = 1;
+            continue;
+        }
+        p++;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, "include", 7) != 0) {
+            settled = 1;
+            continue;
+        }
+        p += 7;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p != '<') {
+            unsafe = settled || *p == '"'; // A local header may define anything
+            continue;
+        }
+        char *end = strchr(++p, '>');
+        if (!end) continue;
+        *end = '\0';
+        for (int k = 0; k < num_names; k++) {
+            if (strcmp(names[k], p) != 0) continue;
+            if (settled) unsafe = 1;
+            included[k] = 1;
+        }
+    }
+    fclose(f);
+    if (unsafe) return -1;
+
+    int count = 0;
+    headers[0] = '\0';
+    for (int k = 0; k < num_names; k++) {
+        if (!included[k]) continue;
+        size_t used = strlen(headers);
+        snprintf(headers + used, headers_size - used, "%s%s", count ? "," : "", names[k]);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Hashes the compiler's version and target, so a compiler upgrade never reuses a .gch.
+ */
+uint64_t compiler_identity_hash(void) {
+    static uint64_t identity = 0;
+    if (identity != 0) return identity;
+    identity = FNV_OFFSET_BASIS;
+    int version_fd = create_data_memfd("compiler-version", "", 0);
+    if (version_fd < 0) return identity;
+    Command command;
+    command_init_compiler(&command, USER_COMPILER);
+    command_add(&command, "-dumpfullversion");
+    command_add(&command, "-dumpmachine");
+    CompileResult result;
+    run_compiler(&command, version_fd, &result);
+    char buffer[256];
+    ssize_t n = pread(version_fd, buffer, sizeof(buffer), 0);
+    if (n > 0) identity = fnv1a_hash(identity, buffer, (size_t)n);
+    close(version_fd);
+    return identity;
+}
+
+/**
+ * @brief Returns the cached precompiled header for pch_headers under this variant's flags.
+ *
+ * GCC only accepts a .gch built with the same compiler and code-generation flags, so the
+ * cache key covers the compiler identity, the profile and variant flags and the header list.
+ * A missing entry is built once (header and .gch each into a temp name, then renamed, so
+ * concurrent evaluations sharing the directory never see half a file) and reused by every
+ * later submission.
+ * @param header_path Receives the header to pass to -include; GCC picks up the .gch next to it.
+ * @return 0 on success, -1 when the header could not be built.
+ */
+int ensure_precompiled_header(const CompileVariant *variant, char *header_path, size_t header_size) {
+    uint64_t key = compiler_identity_hash();
+    key = fnv1a_hash(key, compile_profile->flags, strlen(compile_profile->flags) + 1);
+    key = fnv1a_hash(key, variant->spec->flags, strlen(variant->spec->flags) + 1);
+    key = fnv1a_hash(key, pch_headers, strlen(pch_headers));
+    snprintf(header_path, header_size, "%s/pch_%016llx.h", pch_dir, (unsigned long long)key);
+
+    char gch_path[MAX_PATH_SIZE];
+    snprintf(gch_path, sizeof(gch_path), "%s.gch", header_path);
+    if (access(gch_path, R_OK) == 0) return 0;
+
+    // Another evaluation may be compiling against the header, so it too is replaced, not rewritten
+    char tmp_path[MAX_PATH_SIZE + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", header_path, (int)getpid());
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) return -1;
+    char list[sizeof(pch_headers)];
+    snprintf(list, sizeof(list), "%s", pch_headers);
+    for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) fprintf(f, "#include <%s>\n", name);
+    if (fclose(f) != 0 || rename(tmp_path, header_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", gch_path, (int)getpid());
+    Command command;
+    command_init_compiler(&command, USER_COMPILER);
+    command_add_words(&command, compile_profile->flags);
+    command_add_words(&command, variant->spec->flags);
+    command_add(&command, "-x");
+    command_add(&command, "c-header");
+    command_add(&command, "-o");
+    command_add(&command, tmp_path);
+    command_add(&command, header_path);
+    long start = current_time_ms();
+    CompileResult result;
+    run_compiler(&command, -1, &result);
+    if (result != COMPILE_OK || rename(tmp_path, gch_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    printf("    📦 Built precompiled header for %s (%s) in %ld ms\n", variant->spec->name, pch_headers,
+           current_time_ms() - start);
+    return 0;
+}
+
+/**
+ * @brief Estimates the total input the suite feeds the program, generated tests included.
+ */
+long estimate_suite_input_bytes(void) {
+    long total = 0;
+    for (int i = 0; i < suite->num_tests; i++) {
+        const DynamicTestCase *tc = &suite->tests[i];
+        total += is_generated_test(tc) ? tc->gen_size * GENERATED_BYTES_PER_UNIT : (long)strlen(tc->input);
+    }
+    return total;
+}
+
+/**
+ * @brief Resolves the compile profile by name; "auto" (or none) picks one by input size.
+ *
+ * Tiny suites finish before optimization would pay for itself, so they get -O0; suites
+ * past AUTO_PROFILE_LARGE_INPUT are dominated by run time and get the measure profile.
+ * @return 0 on success, -1 on an unknown profile name.
+ */
+int select_compile_profile(const char *name) {
+    size_t num_profiles = sizeof(compile_profiles) / sizeof(compile_profiles[0]);
+    if (name && name[0] != '\0' && strcmp(name, "auto") != 0) {
+        for (size_t k = 0; k < num_profiles; k++) {
+            if (strcmp(compile_profiles[k].name, name) == 0) {
+                compile_profile = &compile_profiles[k];
+                printf("⚙️  Compile profile: %s (%s)\n\n", compile_profile->name, compile_profile->flags);
+                return 0;
+            }
+        }
+        fprintf(stderr, "❌ Unknown compile profile '%s' (known: auto, fast-compile, balanced, release, measure)\n",
+                name);
+        return -1;
+    }
+
+    long input_bytes = estimate_suite_input_bytes();
+    const char *picked = input_bytes < AUTO_PROFILE_SMALL_INPUT ? "fast-compile"
+                       : input_bytes < AUTO_PROFILE_LARGE_INPUT ? "balanced" : "measure";
+    for (size_t k = 0; k < num_profiles; k++) {
+        if (strcmp(compile_profiles[k].name, picked) == 0) compile_profile = &compile_profiles[k];
+    }
+    printf("⚙️  Compile profile: %s (%s), auto for ~%ld KB of test input\n\n", compile_profile->name,
+           compile_profile->flags, input_bytes / 1024);
+    return 0;
 }
 
 /**
- * @brief Runs a single test case in a sandboxed child process.
+ * @brief Runs a program in a sandboxed child process, streaming its output.
+ *
+ * Output is hashed as it arrives and copied to run->spool_fd, so the evaluator never holds
+ * a whole output in memory and a full pipe can no longer stall the child until timeout.
+ * With run->interactor set the program talks to that judge instead (run_interactive_process).
  * @return 0 on success, -1 on timeout or execution error.
  */
-int run_test_process(const char *input, char *output_buffer, size_t buffer_size) {
-    int stdin_pipe[2], stdout_pipe[2];
+int run_test_process(TestRun *run) {
+    if (run->interactor) return run_interactive_process(run);
+
+    int stdin_pipe[2] = {-1, -1}, stdout_pipe[2];
     pid_t pid;
 
-    if (pipe(stdin_pipe) == -1 || pipe(stdout_pipe) == -1) {
+    output_hash_init(&run->output_hash);
+    run->output_bytes = 0;
+    run->output_lines = 0;
+
+    if ((run->input_fd < 0 && pipe(stdin_pipe) == -1) || pipe(stdout_pipe) == -1) {
         perror("pipe failed");
         return -1;
     }
 
+    int program_fd = memfd_path_fd(run->program);
     pid = fork();
     if (pid == -1) {
         perror("fork failed");
+        if (stdin_pipe[0] != -1) {
+            close(stdin_pipe[0]);
+            close(stdin_pipe[1]);
+        }
+        close(stdout_pipe[0]);
+        close(stdout_pipe[1]);
         return -1;
     }
 
     if (pid == 0) { // Child process
-        close(stdin_pipe[1]);
-        close(stdout_pipe[0]);
-        dup2(stdin_pipe[0], STDIN_FILENO);
+        setpgid(0, 0); // Own process group, so kills also reach anything it spawned
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+
+        dup2((run->input_fd >= 0) ? run->input_fd : stdin_pipe[0], STDIN_FILENO);
         dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stdout_pipe[1], STDERR_FILENO); // Redirect stderr to stdout pipe
-        close(stdin_pipe[0]);
+        if (run->merge_stderr) {
+            dup2(stdout_pipe[1], STDERR_FILENO); // Redirect stderr to stdout pipe
+        } else {
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd != -1) dup2(null_fd, STDERR_FILENO);
+        }
+        if (stdin_pipe[0] != -1) {
+            close(stdin_pipe[0]);
+            close(stdin_pipe[1]);
+        }
+        if (run->input_fd > STDERR_FILENO) close(run->input_fd);
+        if (run->spool_fd > STDERR_FILENO) close(run->spool_fd);
+        close(stdout_pipe[0]);
         close(stdout_pipe[1]);
 
         set_child_resource_limits();
         
-        execl(executable_path, executable_path, (char *)NULL);
-        // If execl returns, it must have failed
+        char *const argv[] = {(char *)run->program, NULL};
+        exec_program(run->program, program_fd, argv);
+        // If exec returns, it must have failed
+        int exec_errno = errno;
         perror("execl failed");
-        exit(EXEC_FAILURE_EXIT_CODE);
-    } else { // Parent process
+        _exit(exec_errno == ENOMEM ? EXEC_NO_MEMORY_EXIT_CODE : EXEC_FAILURE_EXIT_CODE);
+    }
+
+    // Parent process
+    setpgid(pid, pid); // Also here, so the group exists before any kill below
+    close(stdout_pipe[1]);
+    int out_fd = stdout_pipe[0];
+    int in_fd = stdin_pipe[1];
+    const char *pending = run->input;
+    size_t pending_len = 0;
+    if (in_fd != -1) {
         close(stdin_pipe[0]);
-        close(stdout_pipe[1]);
+        pending_len = strlen(run->input);
+        fcntl(in_fd, F_SETFL, O_NONBLOCK);
+        if (pending_len == 0) {
+            close(in_fd);
+            in_fd = -1;
+        }
+    }
 
-        // Write input to child's stdin
-        write(stdin_pipe[1], input, strlen(input));
-        close(stdin_pipe[1]);
+    long start = current_time_ms();
+    long last_sample_ms = 0;
+    int status, exited = 0;
+    char chunk[1 << 16];
 
-        long start = current_time_ms();
-        int status;
-        ssize_t bytes_read = 0;
+    // Feed stdin and drain stdout until the child exits and its output is consumed
+    while (current_time_ms() - start < TIMEOUT_SECONDS * 1000 && (!exited || out_fd != -1)) {
+        struct pollfd fds[2];
+        int nfds = 0, out_idx = -1, in_idx = -1;
+        if (out_fd != -1) {
+            out_idx = nfds;
+            fds[nfds++] = (struct pollfd){out_fd, POLLIN, 0};
+        }
+        if (in_fd != -1) {
+            in_idx = nfds;
+            fds[nfds++] = (struct pollfd){in_fd, POLLOUT, 0};
+        }
 
-        // Non-blocking wait with timeout
-        while (current_time_ms() - start < TIMEOUT_SECONDS * 1000) {
-            if (waitpid(pid, &status, WNOHANG) == pid) {
-                // Child terminated
-                if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-                    bytes_read = read(stdout_pipe[0], output_buffer, buffer_size - 1);
-                    if(bytes_read >= 0) output_buffer[bytes_read] = '\0';
-                    close(stdout_pipe[0]);
-                    return 0;
+        int ready = poll(fds, nfds, 10);
+        int got_output = 0;
+        if (ready > 0 && out_idx != -1 && fds[out_idx].revents) {
+            ssize_t n = read(out_fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                got_output = 1;
+                output_hash_update(&run->output_hash, chunk, n);
+                run->output_bytes += n;
+                if (run->spool_fd != -1 && write(run->spool_fd, chunk, n) != n) {
+                    perror("write (output spool)");
+                }
+                run->output_lines += byte_kernels.count_newlines(chunk, n);
+                if ((run->max_output_bytes > 0 && run->output_bytes > run->max_output_bytes) ||
+                    (run->max_output_lines > 0 && run->output_lines > run->max_output_lines)) {
+                    // Runaway printer: stop it now rather than at the timeout
+                    kill(-pid, SIGKILL);
+                    run->output_limit_exceeded = 1;
+                    break;
                 }
-                close(stdout_pipe[0]);
-                return -1; // Child crashed or exited with error
+                if (run->comparator) {
+                    comparator_feed(run->comparator, chunk, n);
+                    if (run->comparator->mismatch_offset >= 0) {
+                        // Wrong answer already: stop the program instead of draining it
+                        kill(-pid, SIGKILL);
+                        run->aborted = 1;
+                        break;
+                    }
+                }
+            } else if (n == 0 || errno != EINTR) {
+                close(out_fd);
+                out_fd = -1;
+            }
+        }
+        if (ready > 0 && in_idx != -1 && fds[in_idx].revents) {
+            ssize_t n = write(in_fd, pending, pending_len);
+            if (n > 0) {
+                pending += n;
+                pending_len -= n;
+            }
+            // Done, or the child stopped reading its input
+            if (pending_len == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                close(in_fd);
+                in_fd = -1;
             }
-            usleep(10000); // Sleep for 10ms
         }
 
-        // Timeout occurred
-        kill(pid, SIGKILL);
-        waitpid(pid, &status, 0);
-        close(stdout_pipe[0]);
+        if (!exited) {
+            sample_peak_memory(run, pid, &last_sample_ms);
+            if (wait4(pid, &status, WNOHANG, &run->usage) == pid) {
+                exited = 1;
+                // What is left in the pipe was written before exit; don't wait on descendants
+                if (out_fd != -1) fcntl(out_fd, F_SETFL, O_NONBLOCK);
+            }
+        } else if (out_fd != -1 && !got_output) {
+            close(out_fd);
+            out_fd = -1;
+        }
+    }
+
+    if (in_fd != -1) close(in_fd);
+    if (out_fd != -1) close(out_fd);
+
+    if (!exited) {
+        // Timeout occurred (or the run was killed above)
+        run->wall_timeout = !run->aborted && !run->output_limit_exceeded;
+        kill(-pid, SIGKILL);
+        wait4(pid, &status, 0, &run->usage);
+        run->wait_status = status;
         return -1;
     }
+    run->wait_status = status;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
 }
 
 /**
- * @brief Analyzes memory usage by running the program with Valgrind.
+ * @brief Analyzes memory usage by running the program with Valgrind, or its ASan variant.
  * @return A score from 0 to 100.
  */
 float analyze_memory(void) {
-    if (test_suite.num_tests == 0) return 100.0f;
+    if (suite->num_tests == 0) return 100.0f;
 
-    char command[1024];
-    // Use the first test case for memory analysis
-    snprintf(command, sizeof(command), "echo \"%s\" | valgrind --tool=memcheck --leak-check=full --log-file=%s %s",
-             test_suite.tests[0].input, VALGRIND_LOG_PATH, executable_path);
-    
-    system(command);
+    // Use the first literal test case for memory analysis
+    int mem_test = 0;
+    while (mem_test < suite->num_tests - 1 && is_generated_test(&suite->tests[mem_test])) {
+        mem_test++;
+    }
+
+    // An ASan build from the compile manifest is much faster than Valgrind
+    const char *asan_path = variant_executable("asan");
+    if (asan_path) return analyze_memory_asan(asan_path, mem_test);
+
+    Command command;
+    command_init(&command, "valgrind");
+    command_add(&command, "--tool=memcheck");
+    command_add(&command, "--leak-check=full");
+    char log_option[MAX_PATH_SIZE + 16];
+    snprintf(log_option, sizeof(log_option), "--log-file=%s", memory_log_path);
+    command_add(&command, log_option);
+    command_add(&command, executable_path);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    run_command(&command, suite->tests[mem_test].input, null_fd, -1, NULL);
+    if (null_fd >= 0) close(null_fd);
 
-    FILE *log_file = fopen(VALGRIND_LOG_PATH, "r");
+    FILE *log_file = fopen(memory_log_path, "r");
     if (!log_file) {
         fprintf(stderr, "Could not open valgrind log file.\n");
         return 0.0f;
@@ -546,7 +2656,7 @@ float analyze_memory(void) {
         }
     }
     fclose(log_file);
-    remove(VALGRIND_LOG_PATH);
+    remove_spool(memory_log_path);
 
     if (definitely_lost == 0) {
         return 100.0f;
@@ -559,21 +2669,71 @@ float analyze_memory(void) {
 }
 
 /**
- * @brief Checks if the program handles signals gracefully.
+ * @brief Memory analysis on the ASan variant: leaks are scored like Valgrind's definitely
+ *        lost bytes, and any memory error reported by ASan scores 0.
  * @return A score from 0 to 100.
  */
-float check_robustness(void) {
-    pid_t pid = fork();
-    if (pid == -1) {
-        perror("fork for robustness check failed");
+float analyze_memory_asan(const char *asan_path, int mem_test) {
+    char asan_options[64];
+    snprintf(asan_options, sizeof(asan_options), "ASAN_OPTIONS=detect_leaks=1:exitcode=%d", ASAN_ERROR_EXIT_CODE);
+    Command command;
+    command_init(&command, asan_path);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    int log_fd = open(memory_log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (log_fd >= 0) run_command(&command, suite->tests[mem_test].input, null_fd, log_fd, asan_options);
+    if (null_fd >= 0) close(null_fd);
+    if (log_fd >= 0) close(log_fd);
+
+    FILE *log_file = fopen(memory_log_path, "r");
+    if (!log_file) {
+        fprintf(stderr, "Could not open ASan log file.\n");
         return 0.0f;
     }
 
-    if (pid == 0) { // Child process
-        // Run the program with no input, it should just wait or exit
-        execl(executable_path, executable_path, (char *)NULL);
-        exit(EXEC_FAILURE_EXIT_CODE);
-    } else { // Parent process
+    char line[512];
+    long leaked = 0;
+    int memory_error = 0;
+    while (fgets(line, sizeof(line), log_file)) {
+        long bytes;
+        if (sscanf(line, "SUMMARY: AddressSanitizer: %ld byte(s) leaked", &bytes) == 1) {
+            leaked = bytes;
+        } else if (strstr(line, "ERROR: AddressSanitizer:")) {
+            memory_error = 1;
+        }
+    }
+    fclose(log_file);
+    remove_spool(memory_log_path);
+
+    if (memory_error) {
+        return 0.0f;
+    } else if (leaked == 0) {
+        return 100.0f;
+    } else if (leaked < 100) {
+        return 75.0f;
+    } else if (leaked < 1024) {
+        return 25.0f;
+    }
+    return 0.0f;
+}
+
+/**
+ * @brief Checks if the program handles signals gracefully.
+ * @return A score from 0 to 100.
+ */
+float check_robustness(void) {
+    int program_fd = memfd_path_fd(executable_path);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork for robustness check failed");
+        return 0.0f;
+    }
+
+    if (pid == 0) { // Child process
+        // Run the program with no input, it should just wait or exit
+        char *const argv[] = {executable_path, NULL};
+        exec_program(executable_path, program_fd, argv);
+        exit(EXEC_FAILURE_EXIT_CODE);
+    } else { // Parent process
         int status;
         usleep(ROBUSTNESS_SIGINT_WAIT_US); // Wait a bit before sending signal
 
@@ -606,3 +2766,3629 @@ void trim_trailing_whitespace(char *str) {
     }
     str[len] = '\0';
 }
+
+// --- Generated Test Inputs ---
+
+/**
+ * @brief SplitMix64 step; deterministic across platforms so seeds reproduce exactly.
+ */
+uint64_t splitmix64_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Emits "N" followed by N integers in [-1e9, 1e9].
+ */
+void emit_random_ints(FILE *out, uint64_t seed, long size) {
+    uint64_t state = seed;
+    fprintf(out, "%ld\n", size);
+    for (long i = 0; i < size; i++) {
+        long long value = (long long)(splitmix64_next(&state) % 2000000001ULL) - 1000000000LL;
+        fprintf(out, (i + 1 < size) ? "%lld " : "%lld\n", value);
+    }
+}
+
+/**
+ * @brief Emits "n m" followed by m undirected edges "u v" (1-indexed, no self-loops).
+ */
+void emit_random_graph(FILE *out, uint64_t seed, long size) {
+    uint64_t state = seed;
+    long n = (size < 2) ? 2 : size;
+    long max_edges = (n <= 2000) ? n * (n - 1) / 2 : 2 * n;
+    long m = (2 * n < max_edges) ? 2 * n : max_edges;
+    fprintf(out, "%ld %ld\n", n, m);
+    for (long i = 0; i < m; i++) {
+        long u = (long)(splitmix64_next(&state) % (uint64_t)n);
+        long v = (long)(splitmix64_next(&state) % (uint64_t)(n - 1));
+        if (v >= u) v++;
+        fprintf(out, "%ld %ld\n", u + 1, v + 1);
+    }
+}
+
+BuiltinGenerator builtin_generators[] = {
+    {"random_ints", emit_random_ints},
+    {"random_graph", emit_random_graph},
+    {NULL, NULL}
+};
+
+/**
+ * @brief Looks up a built-in generator by name.
+ * @return The generator, or NULL if the name is not built in.
+ */
+BuiltinGenerator *find_builtin_generator(const char *name) {
+    for (BuiltinGenerator *g = builtin_generators; g->name; g++) {
+        if (strcmp(g->name, name) == 0) {
+            return g;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief True if the test's input is produced by a generator instead of stored literally.
+ */
+int is_generated_test(const DynamicTestCase *tc) {
+    return tc->generator[0] != '\0';
+}
+
+/**
+ * @brief Resolves a suite-relative path against the directory of the suite file.
+ * @return 0 on success, -1 (with a message) if the result does not fit.
+ */
+int resolve_suite_path(const char *path, char *resolved, size_t resolved_size) {
+    int n;
+    if (path[0] == '/' || suite_dir[0] == '\0') {
+        n = snprintf(resolved, resolved_size, "%s", path);
+    } else {
+        n = snprintf(resolved, resolved_size, "%s/%s", suite_dir, path);
+    }
+    if (n < 0 || (size_t)n >= resolved_size) {
+        fprintf(stderr, "❌ Path too long: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compiles a generator or reference program with optimization.
+ * @return 0 on success, -1 on failure.
+ */
+int compile_auxiliary_program(const char *source_filename, const char *output_path) {
+    Command command;
+    command_init_compiler(&command, USER_COMPILER);
+    command_add(&command, "-O2");
+    command_add(&command, "-o");
+    command_add(&command, output_path);
+    command_add(&command, source_filename);
+    command_add_words(&command, USER_LINK_FLAGS);
+
+    CompileResult result;
+    run_compiler(&command, -1, &result);
+    return result == COMPILE_OK ? 0 : -1;
+}
+
+/**
+ * @brief Returns the compiled executable for a generator source, compiling it on first use.
+ */
+const char *generator_executable(const char *source) {
+    for (int i = 0; i < num_compiled_generators; i++) {
+        if (strcmp(compiled_generators[i].source, source) == 0) {
+            return compiled_generators[i].executable;
+        }
+    }
+    if (num_compiled_generators >= MAX_GENERATORS) return NULL;
+
+    CompiledGenerator *gen = &compiled_generators[num_compiled_generators];
+    snprintf(gen->executable, sizeof(gen->executable), "%s/generator_%d", temp_dir_path,
+             num_compiled_generators);
+    if (compile_auxiliary_program(source, gen->executable) != 0) {
+        fprintf(stderr, "❌ Failed to compile generator %s\n", source);
+        return NULL;
+    }
+    snprintf(gen->source, sizeof(gen->source), "%s", source);
+    num_compiled_generators++;
+    return gen->executable;
+}
+
+/**
+ * @brief Starts the input generator for a test.
+ * @return Read end of the generator's stdout pipe, or -1 on failure.
+ */
+int spawn_input_generator(const DynamicTestCase *tc, pid_t *gen_pid) {
+    BuiltinGenerator *builtin = find_builtin_generator(tc->generator);
+
+    const char *gen_exe = NULL;
+    if (!builtin) {
+        gen_exe = generator_executable(tc->generator);
+        if (!gen_exe) return -1;
+    }
+
+    int gen_pipe[2];
+    if (pipe(gen_pipe) == -1) {
+        perror("pipe for generator failed");
+        return -1;
+    }
+
+    *gen_pid = fork();
+    if (*gen_pid == -1) {
+        perror("fork for generator failed");
+        close(gen_pipe[0]);
+        close(gen_pipe[1]);
+        return -1;
+    }
+
+    if (*gen_pid == 0) { // Generator process
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL); // Die quietly once the program stops reading
+        close(gen_pipe[0]);
+
+        if (builtin) {
+            // Fresh stream: the inherited stdout buffer may still hold the evaluator's own output
+            FILE *out = fdopen(gen_pipe[1], "w");
+            if (!out) _exit(1);
+            static char out_buf[1 << 16];
+            setvbuf(out, out_buf, _IOFBF, sizeof(out_buf));
+            builtin->emit(out, tc->seed, tc->gen_size);
+            fclose(out);
+            _exit(0);
+        }
+
+        dup2(gen_pipe[1], STDOUT_FILENO);
+        close(gen_pipe[1]);
+
+        char seed_arg[32], size_arg[32];
+        snprintf(seed_arg, sizeof(seed_arg), "%llu", (unsigned long long)tc->seed);
+        snprintf(size_arg, sizeof(size_arg), "%ld", tc->gen_size);
+        execl(gen_exe, gen_exe, seed_arg, size_arg, (char *)NULL);
+        _exit(EXEC_FAILURE_EXIT_CODE);
+    }
+
+    close(gen_pipe[1]);
+    return gen_pipe[0];
+}
+
+/**
+ * @brief Opens a read-only stream over a string.
+ */
+FILE *open_string_stream(const char *text) {
+    // fmemopen rejects zero-length buffers
+    size_t len = strlen(text);
+    return len ? fmemopen((void *)text, len, "r") : fopen("/dev/null", "r");
+}
+
+/**
+ * @brief Reads the start of a spooled output for failure messages, trailing whitespace trimmed.
+ */
+void read_output_preview(const char *path, char *buffer, size_t buffer_size) {
+    buffer[0] = '\0';
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    size_t n = fread(buffer, 1, buffer_size - 1, f);
+    buffer[n] = '\0';
+    fclose(f);
+    trim_trailing_whitespace(buffer);
+}
+
+/**
+ * @brief Compiles the suite's reference solution on first use.
+ * @return 0 on success, -1 on failure.
+ */
+int ensure_reference_compiled(void) {
+    if (reference_executable_path[0] != '\0') return 0;
+
+    char ref_path[MAX_PATH_SIZE];
+    snprintf(ref_path, sizeof(ref_path), "%s/reference_program", temp_dir_path);
+    if (compile_auxiliary_program(suite->reference_source, ref_path) != 0) {
+        fprintf(stderr, "❌ Failed to compile reference %s\n", suite->reference_source);
+        return -1;
+    }
+    snprintf(reference_executable_path, sizeof(reference_executable_path), "%s", ref_path);
+    reference_hash = hash_file_contents(reference_executable_path);
+    return 0;
+}
+
+/**
+ * @brief Runs one test and decides its verdict.
+ *
+ * A live run is judged by its comparator while the output streams, and is killed at the
+ * first wrong byte. A reused exact-mode run passes on matching normalized hashes without
+ * being read back; otherwise its spool is replayed through the comparator. Generated tests
+ * take their expected output from the reference run. With a suite checker only the run
+ * itself is judged here; the checker decides the rest (see launch_checker).
+ * @return 0 on pass, JUDGE_WRONG_OUTPUT (offset in mismatch_offset), JUDGE_OUTPUT_LIMIT,
+ *         JUDGE_NEEDS_CHECKER for a clean run awaiting the checker, -1 on timeout or execution error.
+ */
+int judge_test(int index, MemoEntry **actual_run, long *mismatch_offset, int *reused) {
+    const DynamicTestCase *tc = &suite->tests[index];
+    uint64_t expected_hash = tc->expected_hash;
+    long expected_length = tc->expected_length;
+    const char *expected_path = NULL;
+
+    if (is_generated_test(tc)) {
+        if (ensure_reference_compiled() != 0) return -1;
+
+        int reference_reused = 0;
+        MemoEntry *expected = run_memoized(tc, reference_executable_path, reference_hash, 0,
+                                           &reference_reused, NULL);
+        if (!expected || expected->status != 0) {
+            fprintf(stderr, "❌ Reference program failed on test %d\n", index + 1);
+            return -1;
+        }
+        expected_hash = expected->output_hash;
+        expected_length = expected->output_length;
+        expected_path = expected->output_path;
+    }
+
+    if (suite->checker_source[0] != '\0') {
+        // No comparator: a checker may accept output that differs from the expected one
+        MemoEntry *actual = run_memoized(tc, executable_path, executable_hash, 1, reused, NULL);
+        *actual_run = actual;
+        if (actual && actual->status == RUN_OUTPUT_LIMIT) return JUDGE_OUTPUT_LIMIT;
+        return (actual && actual->status == 0) ? JUDGE_NEEDS_CHECKER : -1;
+    }
+
+    FILE *expected_stream = expected_path ? fopen(expected_path, "r")
+                                          : open_string_stream(tc->expected_output);
+    if (!expected_stream) {
+        perror("fopen (expected output)");
+        return -1;
+    }
+    OutputComparator comparator;
+    comparator_init(&comparator, &tc->comparator, expected_stream);
+
+    MemoEntry *actual = run_memoized(tc, executable_path, executable_hash, 1, reused, &comparator);
+    *actual_run = actual;
+
+    int result;
+    if (actual && actual->status == RUN_ABORTED) {
+        result = JUDGE_WRONG_OUTPUT;
+    } else if (actual && actual->status == RUN_OUTPUT_LIMIT) {
+        result = JUDGE_OUTPUT_LIMIT;
+    } else if (!actual || actual->status != 0) {
+        result = -1;
+    } else if (*reused && tc->comparator.mode == COMPARE_EXACT &&
+               actual->output_hash == expected_hash && actual->output_length == expected_length) {
+        result = 0;
+    } else if (*reused && comparator_feed_file(&comparator, actual->output_path) != 0) {
+        result = -1;
+    } else {
+        result = comparator_finish(&comparator) == 0 ? 0 : JUDGE_WRONG_OUTPUT;
+    }
+    *mismatch_offset = comparator.mismatch_offset;
+
+    fclose(expected_stream);
+    return result;
+}
+
+// --- Run Memoization ---
+
+/**
+ * @brief FNV-1a over a byte range, continuing from a previous hash value.
+ */
+uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Starts a normalized output hash.
+ */
+void output_hash_init(OutputHash *h) {
+    h->hash = h->ws_hash = FNV_OFFSET_BASIS;
+    h->length = h->ws_length = 0;
+}
+
+/**
+ * @brief Feeds output bytes into a normalized hash.
+ *
+ * Whitespace is hashed tentatively; the committed hash only advances past it once a
+ * non-whitespace byte follows, so trailing whitespace never affects the result.
+ */
+void output_hash_update(OutputHash *h, const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        size_t run = byte_kernels.find_space(data + i, len - i);
+        if (run > 0) {
+            h->ws_hash = fnv1a_hash(h->ws_hash, data + i, run);
+            h->ws_length += run;
+            h->hash = h->ws_hash;
+            h->length = h->ws_length;
+            i += run;
+        }
+
+        run = byte_kernels.skip_space(data + i, len - i);
+        h->ws_hash = fnv1a_hash(h->ws_hash, data + i, run);
+        h->ws_length += run;
+        i += run;
+    }
+}
+
+/**
+ * @brief Hashes a file's contents (used to identify compiled binaries and generator sources).
+ */
+uint64_t hash_file_contents(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("fopen (hash)");
+        return 0;
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    unsigned char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        hash = fnv1a_hash(hash, buf, n);
+    }
+    fclose(f);
+    return hash;
+}
+
+/**
+ * @brief Memo key for running a program on a test's input under the current limits.
+ *
+ * Expected output, description and weight are deliberately excluded so tests that share an
+ * input share one run, and rubric-only suite changes still hit the cache.
+ */
+uint64_t run_memo_key(uint64_t program_hash, const DynamicTestCase *tc) {
+    const long limits[] = {TIMEOUT_SECONDS, MEMORY_LIMIT_MB, CPU_TIME_LIMIT_S, MAX_OUTPUT_SIZE,
+                           tc->output_limit_bytes, tc->output_limit_lines};
+
+    uint64_t hash = fnv1a_hash(FNV_OFFSET_BASIS, &program_hash, sizeof(program_hash));
+    hash = fnv1a_hash(hash, limits, sizeof(limits));
+
+    if (is_generated_test(tc)) {
+        hash = fnv1a_hash(hash, "G", 1);
+        hash = fnv1a_hash(hash, tc->generator, strlen(tc->generator));
+        hash = fnv1a_hash(hash, &tc->seed, sizeof(tc->seed));
+        hash = fnv1a_hash(hash, &tc->gen_size, sizeof(tc->gen_size));
+        if (!find_builtin_generator(tc->generator)) {
+            uint64_t source_hash = hash_file_contents(tc->generator);
+            hash = fnv1a_hash(hash, &source_hash, sizeof(source_hash));
+        }
+    } else {
+        hash = fnv1a_hash(hash, "L", 1);
+        hash = fnv1a_hash(hash, tc->input, strlen(tc->input));
+    }
+    return hash;
+}
+
+/**
+ * @brief Builds the on-disk cache path for a memo key.
+ * @return 0 on success, -1 if --memo-dir is too long for it.
+ */
+int memo_disk_path(uint64_t key, const char *suffix, char *path, size_t path_size) {
+    int n = snprintf(path, path_size, "%s/%016llx.%s", memo_dir, (unsigned long long)key, suffix);
+    return n >= 0 && (size_t)n < path_size ? 0 : -1;
+}
+
+/**
+ * @brief Records a new run in the in-memory memo.
+ * @return The entry, or NULL if the memo is full.
+ */
+MemoEntry *memo_add(uint64_t key, int status) {
+    if (!memo_entries) {
+        memo_capacity = 2 * suite->num_tests + 1; // User and reference runs
+        memo_entries = calloc(memo_capacity, sizeof(MemoEntry));
+        if (!memo_entries) return NULL;
+    }
+    if (num_memo_entries >= memo_capacity) return NULL;
+
+    MemoEntry *entry = &memo_entries[num_memo_entries++];
+    memset(entry, 0, sizeof(*entry));
+    entry->key = key;
+    entry->status = status;
+    return entry;
+}
+
+/**
+ * @brief Finds a memoized run, consulting the on-disk cache if one is configured.
+ * @return The entry, or NULL on a miss.
+ */
+MemoEntry *memo_lookup(uint64_t key) {
+    for (int i = 0; i < num_memo_entries; i++) {
+        if (memo_entries[i].key == key) {
+            return &memo_entries[i];
+        }
+    }
+    if (memo_dir[0] == '\0') return NULL;
+
+    char path[MAX_PATH_SIZE];
+    if (memo_disk_path(key, "meta", path, sizeof(path)) != 0) return NULL;
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+
+    int status, verdict = -1, wait_status = 0;
+    unsigned long long hash;
+    long length, bytes = 0;
+    int fields = fscanf(f, "%d %llx %ld %ld %d %d", &status, &hash, &length, &bytes, &verdict, &wait_status);
+    fclose(f);
+    if (fields < 3) return NULL;
+
+    if (memo_disk_path(key, "out", path, sizeof(path)) != 0) return NULL;
+    if (status == 0 && access(path, R_OK) != 0) return NULL;
+
+    MemoEntry *entry = memo_add(key, status);
+    if (entry) {
+        entry->output_hash = hash;
+        entry->output_length = length;
+        entry->output_bytes = bytes;
+        // Entries from before verdicts were recorded only know pass, OLE or failure
+        entry->verdict = (verdict >= 0 && verdict < VERDICT_COUNT) ? (Verdict)verdict
+                       : status == 0 ? VERDICT_AC : status == RUN_OUTPUT_LIMIT ? VERDICT_OLE : VERDICT_RE;
+        entry->wait_status = wait_status;
+        if (status == 0) snprintf(entry->output_path, sizeof(entry->output_path), "%s", path);
+    }
+    return entry;
+}
+
+/**
+ * @brief True when a run would end the same way if repeated: a clean exit, an error exit or
+ *        crash, or the output-limit kill. Timeouts, MLE and outside kills depend on load.
+ */
+int memo_is_deterministic(const MemoEntry *entry) {
+    if (entry->verdict == VERDICT_AC || entry->verdict == VERDICT_OLE) return 1;
+    return entry->verdict == VERDICT_RE &&
+           !(WIFSIGNALED(entry->wait_status) && WTERMSIG(entry->wait_status) == SIGKILL);
+}
+
+/**
+ * @brief Publishes a finished run to the on-disk cache.
+ *
+ * Output and metadata are written under per-process names and renamed into place, metadata
+ * last, so concurrent evaluators sharing the cache never see partial entries.
+ */
+void memo_persist(MemoEntry *entry, const char *tmp_output_path) {
+    char path[MAX_PATH_SIZE], tmp_path[MAX_PATH_SIZE + 32];
+
+    if (entry->status == 0) {
+        if (memo_disk_path(entry->key, "out", path, sizeof(path)) != 0 || rename(tmp_output_path, path) != 0) {
+            perror("rename (memo)");
+            remove(tmp_output_path);
+            return;
+        }
+        snprintf(entry->output_path, sizeof(entry->output_path), "%s", path);
+    } else {
+        remove(tmp_output_path);
+    }
+
+    if (memo_disk_path(entry->key, "meta", path, sizeof(path)) != 0) return;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) return;
+    fprintf(f, "%d %016llx %ld %ld %d %d\n", entry->status, (unsigned long long)entry->output_hash,
+            entry->output_length, entry->output_bytes, (int)entry->verdict, entry->wait_status);
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+    }
+}
+
+/**
+ * @brief Runs a program on a test's input, or reuses the run of an identical input.
+ *
+ * The output is spooled to disk and hashed while it streams; the memo keeps only the hash
+ * and the spool path. A comparator, if given, is fed the live output (not a reused one) and
+ * the program is killed at its first mismatch. Such a truncated run is never memoized.
+ * @return The memo entry for the run (aborted_run for a killed one), or NULL if it could
+ *         not be recorded.
+ */
+MemoEntry *run_memoized(const DynamicTestCase *tc, const char *program, uint64_t program_hash,
+                        int merge_stderr, int *reused, OutputComparator *comparator) {
+    // Output with stderr merged in differs from the same binary's plain output (a submission
+    // that is a copy of the reference), so the two never share a run
+    uint64_t key = run_memo_key(program_hash, tc);
+    if (merge_stderr) key = fnv1a_hash(key, "+stderr", 7);
+    MemoEntry *entry = memo_lookup(key);
+    if (entry) {
+        *reused = 1;
+        return entry;
+    }
+
+    // With --in-memory (and no on-disk memo to persist into), the spool is a memfd kept open
+    // for as long as the memo refers to it
+    char run_path[MAX_PATH_SIZE];
+    int spool_fd;
+    if (memo_dir[0] != '\0') {
+        int n = snprintf(run_path, sizeof(run_path), "%s/%016llx.out.%d", memo_dir,
+                         (unsigned long long)key, (int)getpid());
+        if (n < 0 || (size_t)n >= sizeof(run_path)) {
+            errno = ENAMETOOLONG;
+            spool_fd = -1;
+        } else {
+            spool_fd = open(run_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        }
+    } else if (in_memory) {
+        spool_fd = create_data_memfd("output-spool", "", 0);
+        memfd_path(spool_fd, run_path, sizeof(run_path));
+    } else {
+        snprintf(run_path, sizeof(run_path), "%s/run_%016llx.out", temp_dir_path,
+                 (unsigned long long)key);
+        spool_fd = open(run_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    }
+    if (spool_fd == -1) {
+        perror("open (output spool)");
+        return NULL;
+    }
+
+    TestRun run = {0};
+    run.program = program;
+    run.input = tc->input;
+    run.input_fd = -1;
+    run.spool_fd = spool_fd;
+    run.merge_stderr = merge_stderr;
+    run.comparator = comparator;
+    run.max_output_bytes = tc->output_limit_bytes;
+    run.max_output_lines = tc->output_limit_lines;
+
+    int status = -1;
+    pid_t gen_pid = -1;
+    if (is_generated_test(tc)) {
+        run.input_fd = spawn_input_generator(tc, &gen_pid);
+    }
+    if (!is_generated_test(tc) || run.input_fd != -1) {
+        status = run_test_process(&run);
+    }
+
+    if (run.input_fd != -1) close(run.input_fd);
+    if (gen_pid > 0) {
+        // The program may stop reading early; don't wait for the generator to finish
+        int gen_status;
+        kill(gen_pid, SIGKILL);
+        waitpid(gen_pid, &gen_status, 0);
+    }
+    if (memfd_path_fd(run_path) < 0) close(spool_fd);
+
+    if (run.aborted) {
+        // Partial output, kept for the failure report until the next aborted run
+        if (aborted_run.output_path[0] != '\0') remove_spool(aborted_run.output_path);
+        aborted_run.key = key;
+        aborted_run.status = RUN_ABORTED;
+        snprintf(aborted_run.output_path, sizeof(aborted_run.output_path), "%s", run_path);
+        return &aborted_run;
+    }
+
+    // Output limits are part of the key, so an OLE verdict is as reusable as any other
+    entry = memo_add(key, run.output_limit_exceeded ? RUN_OUTPUT_LIMIT : status);
+    if (!entry) {
+        remove_spool(run_path);
+        return NULL;
+    }
+    entry->output_hash = run.output_hash.hash;
+    entry->output_length = run.output_hash.length;
+    entry->output_bytes = run.output_bytes;
+    entry->verdict = classify_run(&run);
+    entry->wait_status = run.wait_status;
+
+    // Only reproducible outcomes go to disk; a timeout stays in this run's memo
+    if (memo_dir[0] != '\0' && memo_is_deterministic(entry)) {
+        memo_persist(entry, run_path);
+    } else if (status == 0) {
+        snprintf(entry->output_path, sizeof(entry->output_path), "%s", run_path);
+    } else {
+        remove_spool(run_path);
+    }
+    return entry;
+}
+
+// --- Sharding ---
+
+/**
+ * @brief True when this process runs only part of the suite.
+ */
+int is_partial_run(void) {
+    return shard_count > 0 || test_id_spec != NULL;
+}
+
+/**
+ * @brief Marks the tests this process runs from --tests and --shard.
+ *
+ * Shards take test indices round-robin (index % N == i - 1), so every shard gets a
+ * similar mix of the suite and the split is identical on every node.
+ * @return Number of selected tests, or -1 on an invalid test list.
+ */
+int select_tests(void) {
+    test_outcomes = calloc(suite->num_tests > 0 ? suite->num_tests : 1, sizeof(TestOutcome));
+    if (!test_outcomes) {
+        perror("calloc for test outcomes failed");
+        return -1;
+    }
+
+    if (test_id_spec) {
+        char *spec = strdup(test_id_spec);
+        char *saveptr = NULL;
+        for (char *tok = strtok_r(spec, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+            int first, last;
+            int fields = sscanf(tok, "%d-%d", &first, &last);
+            if (fields == 1) last = first;
+            if (fields < 1 || first < 1 || last > suite->num_tests || first > last) {
+                fprintf(stderr, "❌ Invalid test id '%s' (suite has %d tests)\n", tok, suite->num_tests);
+                free(spec);
+                return -1;
+            }
+            for (int id = first; id <= last; id++) {
+                test_outcomes[id - 1].selected = 1;
+            }
+        }
+        free(spec);
+    } else {
+        for (int i = 0; i < suite->num_tests; i++) {
+            test_outcomes[i].selected = 1;
+        }
+    }
+
+    int count = 0;
+    for (int i = 0; i < suite->num_tests; i++) {
+        if (shard_count > 0 && i % shard_count != shard_index - 1) {
+            test_outcomes[i].selected = 0;
+        }
+        count += test_outcomes[i].selected;
+    }
+    return count;
+}
+
+int compare_merged_results(const void *a, const void *b) {
+    const MergedTestResult *ra = a, *rb = b;
+    return ra->test_id != rb->test_id ? ra->test_id - rb->test_id : ra->partial - rb->partial;
+}
+
+/**
+ * @brief True when one of the first count collected results is for test_id.
+ */
+int merged_result_seen(const MergedTestResult *results, int count, int test_id) {
+    for (int i = 0; i < count; i++) {
+        if (results[i].test_id == test_id) return 1;
+    }
+    return 0;
+}
+
+int compare_failure_details(const void *a, const void *b) {
+    int id_a = 0, id_b = 0;
+    sscanf(json_object_get_string(*(json_object *const *)a), "Test %d", &id_a);
+    sscanf(json_object_get_string(*(json_object *const *)b), "Test %d", &id_b);
+    return id_a - id_b;
+}
+
+int compare_diff_tests(const void *a, const void *b) {
+    json_object *test_a, *test_b;
+    int id_a = json_object_object_get_ex(*(json_object *const *)a, "test", &test_a) ? json_object_get_int(test_a) : 0;
+    int id_b = json_object_object_get_ex(*(json_object *const *)b, "test", &test_b) ? json_object_get_int(test_b) : 0;
+    return id_a - id_b;
+}
+
+/**
+ * @brief Combines shard result files into one results JSON.
+ *
+ * Per-test outcomes are unioned by test id (first occurrence wins), so passrate, weighted_score
+ * and the verdict and OLE counts are recomputed over exactly the tests that ran; failure
+ * details and diffs of a test come only from the partial whose outcome was kept. Interaction
+ * totals are summed over the kept tests; fields that describe a single run (early stop,
+ * compile manifest, grade-store hits) are dropped, as is each partial's shard. Memory and robustness
+ * scores come from the partial that measured them; execution time is the slowest shard.
+ * @return 0 on success, -1 on failure.
+ */
+int merge_partial_results(const char *output_path, int num_partials, char **partial_paths) {
+    json_object *merged = NULL;
+    MergedTestResult *results = NULL;
+    json_object **details = NULL, **diffs = NULL;
+    int num_results = 0, results_capacity = 0, num_details = 0, details_capacity = 0;
+    int num_diffs = 0, diffs_capacity = 0;
+    long max_time_ms = 0;
+    int reused_total = 0, ole_total = 0, suite_tests = 0;
+    int verdict_totals[VERDICT_COUNT] = {0};
+    int earlier_results; // Results collected from the partials before the current one
+    long queries = 0, round_trips = 0;
+    double latency_ms = 0.0, max_latency_ms = 0.0;
+    json_object *memory_score = NULL, *robustness_score = NULL;
+    json_object **partials = calloc(num_partials, sizeof(json_object *));
+    int status = -1;
+    if (!partials) {
+        perror("calloc for partial results failed");
+        goto done;
+    }
+
+    for (int p = 0; p < num_partials; p++) {
+        partials[p] = json_object_from_file(partial_paths[p]);
+        json_object *field;
+        if (!partials[p] || !json_object_object_get_ex(partials[p], "test_results", &field)) {
+            fprintf(stderr, "❌ %s is not an evaluator results file\n", partial_paths[p]);
+            goto done;
+        }
+
+        earlier_results = num_results;
+        int n = json_object_array_length(field);
+        if (num_results + n > results_capacity) {
+            results_capacity = 2 * (num_results + n);
+            MergedTestResult *grown = realloc(results, results_capacity * sizeof(MergedTestResult));
+            if (!grown) {
+                perror("realloc for merged results failed");
+                goto done;
+            }
+            results = grown;
+        }
+        for (int i = 0; i < n; i++) {
+            json_object *entry = json_object_array_get_idx(field, i), *value;
+            MergedTestResult *r = &results[num_results++];
+            r->test_id = json_object_object_get_ex(entry, "test", &value) ? json_object_get_int(value) : 0;
+            r->passed = json_object_object_get_ex(entry, "passed", &value) && json_object_get_boolean(value);
+            r->weight = json_object_object_get_ex(entry, "weight", &value) ? json_object_get_double(value) : 1.0;
+            r->score = json_object_object_get_ex(entry, "score", &value) ? json_object_get_double(value)
+                                                                         : (r->passed ? 1.0 : 0.0);
+            r->entry = entry;
+            r->partial = p;
+        }
+
+        if (json_object_object_get_ex(partials[p], "failed_test_details", &field)) {
+            n = json_object_array_length(field);
+            if (num_details + n > details_capacity) {
+                details_capacity = 2 * (num_details + n);
+                json_object **grown = realloc(details, details_capacity * sizeof(json_object *));
+                if (!grown) {
+                    perror("realloc for merged details failed");
+                    goto done;
+                }
+                details = grown;
+            }
+            for (int i = 0; i < n; i++) {
+                // An overlapping partial's failures are already reported by the first one
+                json_object *detail = json_object_array_get_idx(field, i);
+                int id = 0;
+                sscanf(json_object_get_string(detail), "Test %d", &id);
+                if (!merged_result_seen(results, earlier_results, id)) details[num_details++] = detail;
+            }
+        }
+
+        if (json_object_object_get_ex(partials[p], "failed_test_diffs", &field)) {
+            n = json_object_array_length(field);
+            if (num_diffs + n > diffs_capacity) {
+                diffs_capacity = 2 * (num_diffs + n);
+                json_object **grown = realloc(diffs, diffs_capacity * sizeof(json_object *));
+                if (!grown) {
+                    perror("realloc for merged diffs failed");
+                    goto done;
+                }
+                diffs = grown;
+            }
+            for (int i = 0; i < n; i++) {
+                json_object *diff = json_object_array_get_idx(field, i), *test;
+                int id = json_object_object_get_ex(diff, "test", &test) ? json_object_get_int(test) : 0;
+                if (!merged_result_seen(results, earlier_results, id)) diffs[num_diffs++] = diff;
+            }
+        }
+
+        if (json_object_object_get_ex(partials[p], "execution_time_ms", &field) &&
+            json_object_get_int64(field) > max_time_ms) {
+            max_time_ms = json_object_get_int64(field);
+        }
+        if (json_object_object_get_ex(partials[p], "reused_results", &field)) {
+            reused_total += json_object_get_int(field);
+        }
+        if (json_object_object_get_ex(partials[p], "suite_tests", &field) &&
+            json_object_get_int(field) > suite_tests) {
+            suite_tests = json_object_get_int(field);
+        }
+        if (!memory_score && json_object_object_get_ex(partials[p], "memory_score", &field) && field) {
+            memory_score = field;
+        }
+        if (!robustness_score && json_object_object_get_ex(partials[p], "robustness_score", &field) && field) {
+            robustness_score = field;
+        }
+    }
+
+    // Union by test id
+    if (num_results > 0) qsort(results, num_results, sizeof(MergedTestResult), compare_merged_results);
+    int unique = 0, passed = 0;
+    double total_weight = 0.0, passed_weight = 0.0;
+    for (int i = 0; i < num_results; i++) {
+        if (unique > 0 && results[unique - 1].test_id == results[i].test_id) continue;
+        results[unique++] = results[i];
+    }
+
+    json_object *merged_results = json_object_new_array();
+    for (int i = 0; i < unique; i++) {
+        total_weight += results[i].weight;
+        if (results[i].passed) passed++;
+        passed_weight += results[i].weight * results[i].score;
+        json_object_array_add(merged_results, json_object_get(results[i].entry));
+
+        // Counted from the kept entries, so overlapping partials add up to total_tests
+        json_object *value;
+        if (json_object_object_get_ex(results[i].entry, "verdict", &value)) {
+            for (int v = 0; v < VERDICT_COUNT; v++) {
+                if (strcmp(json_object_get_string(value), verdict_names[v]) == 0) verdict_totals[v]++;
+            }
+        }
+        if (json_object_object_get_ex(results[i].entry, "output_limit_exceeded", &value) &&
+            json_object_get_boolean(value)) {
+            ole_total++;
+        }
+        if (json_object_object_get_ex(results[i].entry, "round_trips", &value)) {
+            long trips = json_object_get_int64(value);
+            round_trips += trips;
+            if (json_object_object_get_ex(results[i].entry, "queries", &value)) queries += json_object_get_int64(value);
+            if (json_object_object_get_ex(results[i].entry, "mean_latency_ms", &value)) {
+                latency_ms += json_object_get_double(value) * trips;
+            }
+            if (json_object_object_get_ex(results[i].entry, "max_latency_ms", &value) &&
+                json_object_get_double(value) > max_latency_ms) {
+                max_latency_ms = json_object_get_double(value);
+            }
+        }
+    }
+
+    if (num_details > 0) qsort(details, num_details, sizeof(json_object *), compare_failure_details);
+    json_object *merged_details = json_object_new_array();
+    for (int i = 0; i < num_details && i < MAX_FAILED_DETAILS; i++) {
+        json_object_array_add(merged_details, json_object_get(details[i]));
+    }
+
+    if (num_diffs > 0) qsort(diffs, num_diffs, sizeof(json_object *), compare_diff_tests);
+    json_object *merged_diffs = json_object_new_array();
+    for (int i = 0; i < num_diffs && i < MAX_FAILED_DETAILS; i++) {
+        json_object_array_add(merged_diffs, json_object_get(diffs[i]));
+    }
+
+    float passrate = unique > 0 ? (float)passed / unique * 100.0f : 0.0f;
+    float weighted = total_weight > 0 ? (float)(passed_weight / total_weight * 100.0) : 0.0f;
+    char number[32];
+
+    // Metadata and edge cases come from the first partial
+    merged = json_object_get(partials[0]);
+    snprintf(number, sizeof(number), "%.1f", passrate);
+    json_object_object_add(merged, "passrate", json_object_new_double_s(passrate, number));
+    snprintf(number, sizeof(number), "%.1f", weighted);
+    json_object_object_add(merged, "weighted_score", json_object_new_double_s(weighted, number));
+    json_object_object_add(merged, "memory_score", json_object_get(memory_score));
+    json_object_object_add(merged, "robustness_score", json_object_get(robustness_score));
+    json_object_object_add(merged, "tests_passed", json_object_new_int(passed));
+    json_object_object_add(merged, "tests_failed", json_object_new_int(unique - passed));
+    json_object_object_add(merged, "total_tests", json_object_new_int(unique));
+    json_object_object_add(merged, "suite_tests", json_object_new_int(suite_tests));
+    json_object_object_add(merged, "partial", json_object_new_boolean(unique < suite_tests));
+    json_object_object_add(merged, "execution_time_ms", json_object_new_int64(max_time_ms));
+    json_object_object_add(merged, "reused_results", json_object_new_int(reused_total));
+    json_object_object_add(merged, "output_limit_exceeded", json_object_new_int(ole_total));
+    json_object *verdicts = json_object_new_object();
+    for (int v = 0; v < VERDICT_COUNT; v++) {
+        json_object_object_add(verdicts, verdict_names[v], json_object_new_int(verdict_totals[v]));
+    }
+    json_object_object_add(merged, "verdicts", verdicts);
+    json_object_object_add(merged, "failed_test_details", merged_details);
+    json_object_object_add(merged, "failed_test_diffs", merged_diffs);
+    json_object_object_add(merged, "test_results", merged_results);
+    json_object_object_del(merged, "shard");
+    if (json_object_object_get_ex(merged, "interaction", NULL)) {
+        json_object *interaction = json_object_new_object();
+        json_object_object_add(interaction, "queries", json_object_new_int64(queries));
+        json_object_object_add(interaction, "round_trips", json_object_new_int64(round_trips));
+        snprintf(number, sizeof(number), "%.3f", round_trips > 0 ? latency_ms / round_trips : 0.0);
+        json_object_object_add(interaction, "mean_latency_ms",
+                               json_object_new_double_s(round_trips > 0 ? latency_ms / round_trips : 0.0, number));
+        snprintf(number, sizeof(number), "%.3f", max_latency_ms);
+        json_object_object_add(interaction, "max_latency_ms", json_object_new_double_s(max_latency_ms, number));
+        json_object_object_add(merged, "interaction", interaction);
+    }
+
+    // Facts about one run that the union of runs does not have: its early stop, its own
+    // compile (timings differ per shard) and how many of its tests came from the grade store
+    json_object_object_del(merged, "early_stop");
+    json_object_object_del(merged, "target_score");
+    json_object_object_del(merged, "weighted_score_bounds");
+    json_object_object_del(merged, "stored_results");
+    json_object_object_del(merged, "compile_manifest");
+    // Every shard compiled the same source, so these stay when all partials agree on them
+    const char *compile_fields[] = {"compile_result", "compiler_diagnostics", "compiler_diagnostics_dropped"};
+    for (size_t k = 0; k < sizeof(compile_fields) / sizeof(compile_fields[0]); k++) {
+        json_object *first = NULL, *other;
+        int agreed = json_object_object_get_ex(partials[0], compile_fields[k], &first);
+        for (int p = 1; agreed && p < num_partials; p++) {
+            agreed = json_object_object_get_ex(partials[p], compile_fields[k], &other) &&
+                     strcmp(json_object_to_json_string(first), json_object_to_json_string(other)) == 0;
+        }
+        if (!agreed) json_object_object_del(merged, compile_fields[k]);
+    }
+
+    if (json_object_to_file_ext(output_path, merged, JSON_C_TO_STRING_PRETTY) != 0) {
+        fprintf(stderr, "❌ Failed to write %s\n", output_path);
+        goto done;
+    }
+    printf("🧩 Merged %d partial result(s): %d/%d tests, passrate %.1f%%, weighted %.1f%%\n",
+           num_partials, unique, suite_tests, passrate, weighted);
+    status = 0;
+
+done:
+    if (merged) json_object_put(merged);
+    for (int p = 0; partials && p < num_partials; p++) {
+        if (partials[p]) json_object_put(partials[p]);
+    }
+    free(partials);
+    free(results);
+    free(details);
+    free(diffs);
+    return status;
+}
+
+// --- Test Scheduling ---
+
+int compare_test_history(const void *a, const void *b) {
+    uint64_t ka = ((const TestHistory *)a)->key, kb = ((const TestHistory *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * @brief Looks up the failure history of a test, or NULL if it has never run.
+ *
+ * Only the sorted part is searched: entries appended during this run belong to tests that
+ * were already scheduled.
+ */
+TestHistory *find_test_history(uint64_t key) {
+    if (num_sorted_history == 0) return NULL;
+    TestHistory probe = {key, 0, 0};
+    return bsearch(&probe, test_history, num_sorted_history, sizeof(TestHistory), compare_test_history);
+}
+
+/**
+ * @brief Appends an entry to the history, growing it geometrically.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int append_test_history(uint64_t key, int runs, int failures) {
+    if (num_test_history >= test_history_capacity) {
+        int capacity = 2 * test_history_capacity + 64;
+        TestHistory *grown = realloc(test_history, capacity * sizeof(TestHistory));
+        if (!grown) return -1;
+        test_history = grown;
+        test_history_capacity = capacity;
+    }
+    test_history[num_test_history++] = (TestHistory){key, runs, failures};
+    return 0;
+}
+
+/**
+ * @brief Sorts the whole history by key and folds repeated keys into one entry.
+ */
+void sort_test_history(void) {
+    if (num_test_history == 0) return;
+    qsort(test_history, num_test_history, sizeof(TestHistory), compare_test_history);
+    int n = 1;
+    for (int i = 1; i < num_test_history; i++) {
+        if (test_history[i].key == test_history[n - 1].key) {
+            test_history[n - 1].runs += test_history[i].runs;
+            test_history[n - 1].failures += test_history[i].failures;
+        } else {
+            test_history[n++] = test_history[i];
+        }
+    }
+    num_test_history = n;
+    num_sorted_history = n;
+}
+
+/**
+ * @brief Updates the run/failure counts of a test after judging it.
+ *
+ * A test new to the history is appended; repeats of its key are folded in on save.
+ */
+void record_test_history(const DynamicTestCase *tc, int passed) {
+    if (!history_path[0]) return;
+
+    uint64_t key = run_memo_key(0, tc);
+    TestHistory *h = find_test_history(key);
+    if (h) {
+        h->runs++;
+        if (!passed) h->failures++;
+    } else {
+        append_test_history(key, 1, !passed);
+    }
+}
+
+/**
+ * @brief Reads --history ("<key> <runs> <failures>" per line); a missing file is an empty history.
+ */
+void load_test_history(void) {
+    FILE *f = fopen(history_path, "r");
+    if (!f) return;
+
+    unsigned long long key;
+    int runs, failures;
+    while (fscanf(f, "%llx %d %d", &key, &runs, &failures) == 3) {
+        if (append_test_history(key, runs, failures) != 0) break;
+    }
+    fclose(f);
+    sort_test_history();
+}
+
+/**
+ * @brief Rewrites --history via a temporary file so concurrent readers see a whole file.
+ */
+void save_test_history(void) {
+    char tmp_path[MAX_PATH_SIZE + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", history_path, (int)getpid());
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        perror("fopen (history)");
+        return;
+    }
+    sort_test_history();
+    for (int i = 0; i < num_test_history; i++) {
+        fprintf(f, "%016llx %d %d\n", (unsigned long long)test_history[i].key,
+                test_history[i].runs, test_history[i].failures);
+    }
+    if (fclose(f) != 0 || rename(tmp_path, history_path) != 0) {
+        perror("saving history");
+        remove(tmp_path);
+    }
+}
+
+/**
+ * @brief Estimated failure probability of a test, smoothed so unseen tests sit at 0.5.
+ */
+double test_failure_rate(const DynamicTestCase *tc) {
+    const TestHistory *h = num_sorted_history > 0 ? find_test_history(run_memo_key(0, tc)) : NULL;
+    return h ? (h->failures + 1.0) / (h->runs + 2.0) : 0.5;
+}
+
+int compare_test_priority(const void *a, const void *b) {
+    const ScheduledTest *ta = a, *tb = b;
+    if (ta->weight != tb->weight) return ta->weight > tb->weight ? -1 : 1;
+    if (ta->failure_rate != tb->failure_rate) return ta->failure_rate > tb->failure_rate ? -1 : 1;
+    return ta->index - tb->index;
+}
+
+/**
+ * @brief Returns the selected test indices in execution order.
+ *
+ * File order by default. With --target-score, heavy tests go first since they move the
+ * score bounds the most, and among equal weights the historically failing ones, so an
+ * unreachable target is detected early.
+ * @param count Receives the number of scheduled tests.
+ * @return malloc'd index array, or NULL on allocation failure.
+ */
+int *schedule_tests(int *count) {
+    int *order = malloc((suite->num_tests > 0 ? suite->num_tests : 1) * sizeof(int));
+    if (!order) {
+        perror("malloc for test order failed");
+        return NULL;
+    }
+
+    *count = 0;
+    for (int i = 0; i < suite->num_tests; i++) {
+        if (test_outcomes[i].selected && !test_outcomes[i].from_store) order[(*count)++] = i;
+    }
+    if (target_score >= 0 && *count > 1) {
+        // Each test's key is hashed once here; hashing in the comparator would redo it (and
+        // re-read generator sources) O(n log n) times
+        ScheduledTest *tests = malloc(*count * sizeof(ScheduledTest));
+        if (!tests) {
+            perror("malloc for test order failed");
+            free(order);
+            return NULL;
+        }
+        for (int k = 0; k < *count; k++) {
+            const DynamicTestCase *tc = &suite->tests[order[k]];
+            tests[k] = (ScheduledTest){order[k], tc->weight, test_failure_rate(tc)};
+        }
+        qsort(tests, *count, sizeof(ScheduledTest), compare_test_priority);
+        for (int k = 0; k < *count; k++) order[k] = tests[k].index;
+        free(tests);
+    }
+    return order;
+}
+
+// --- Output Comparators ---
+
+/**
+ * @brief Parses a comparator name or {"mode", "abs_epsilon", "rel_epsilon"} object into spec.
+ *
+ * Fields that are not given keep their current values, so tests inherit the suite's epsilons.
+ * @return 0 on success, -1 on an unknown mode.
+ */
+int parse_comparator_spec(json_object *obj, ComparatorSpec *spec) {
+    json_object *mode_obj = obj, *eps_obj;
+    if (json_object_is_type(obj, json_type_object)) {
+        if (json_object_object_get_ex(obj, "abs_epsilon", &eps_obj)) {
+            spec->abs_epsilon = json_object_get_double(eps_obj);
+        }
+        if (json_object_object_get_ex(obj, "rel_epsilon", &eps_obj)) {
+            spec->rel_epsilon = json_object_get_double(eps_obj);
+        }
+        if (!json_object_object_get_ex(obj, "mode", &mode_obj)) return 0;
+    }
+
+    const char *name = json_object_get_string(mode_obj);
+    for (CompareMode mode = COMPARE_EXACT; mode <= COMPARE_NUMERIC; mode++) {
+        if (strcmp(name, comparator_mode_name(mode)) == 0) {
+            spec->mode = mode;
+            return 0;
+        }
+    }
+    fprintf(stderr, "❌ Unknown comparator '%s' (expected exact, whitespace, token or numeric)\n", name);
+    return -1;
+}
+
+const char *comparator_mode_name(CompareMode mode) {
+    switch (mode) {
+    case COMPARE_WHITESPACE: return "whitespace";
+    case COMPARE_TOKEN: return "token";
+    case COMPARE_NUMERIC: return "numeric";
+    default: return "exact";
+    }
+}
+
+void comparator_init(OutputComparator *cmp, const ComparatorSpec *spec, FILE *expected) {
+    cmp->spec = *spec;
+    cmp->expected = expected;
+    cmp->offset = 0;
+    cmp->mismatch_offset = -1;
+    cmp->in_token = 0;
+    cmp->newlines = 0;
+    cmp->exact_tail = 0;
+    cmp->expected_pos = 0;
+    cmp->expected_fill = 0;
+}
+
+/**
+ * @brief Makes sure unread expected bytes are buffered.
+ * @return 0 once the expected stream is exhausted.
+ */
+int comparator_fill_expected(OutputComparator *cmp) {
+    if (cmp->expected_pos < cmp->expected_fill) return 1;
+    cmp->expected_fill = fread(cmp->expected_buffer, 1, sizeof(cmp->expected_buffer), cmp->expected);
+    cmp->expected_pos = 0;
+    return cmp->expected_fill > 0;
+}
+
+/**
+ * @brief Skips whitespace in the expected stream.
+ * @return Line breaks skipped, or -1 if the stream ended.
+ */
+int comparator_skip_expected_space(OutputComparator *cmp) {
+    int newlines = 0;
+    while (comparator_fill_expected(cmp)) {
+        const char *p = cmp->expected_buffer + cmp->expected_pos;
+        size_t run = byte_kernels.skip_space(p, cmp->expected_fill - cmp->expected_pos);
+        newlines += byte_kernels.count_newlines(p, run);
+        cmp->expected_pos += run;
+        if (cmp->expected_pos < cmp->expected_fill) return newlines;
+    }
+    return -1;
+}
+
+/**
+ * @brief True if both tokens are numbers within the spec's absolute or relative epsilon.
+ */
+int numeric_tokens_match(const OutputComparator *cmp) {
+    if (cmp->actual_length >= MAX_COMPARE_TOKEN || cmp->expected_length >= MAX_COMPARE_TOKEN) return 0;
+
+    char actual[MAX_COMPARE_TOKEN + 1], expected[MAX_COMPARE_TOKEN + 1];
+    memcpy(actual, cmp->actual_token, cmp->actual_length);
+    actual[cmp->actual_length] = '\0';
+    memcpy(expected, cmp->expected_token, cmp->expected_length);
+    expected[cmp->expected_length] = '\0';
+
+    char *end_a, *end_e;
+    double a = strtod(actual, &end_a);
+    double e = strtod(expected, &end_e);
+    if (*end_a != '\0' || *end_e != '\0' || !isfinite(a) || !isfinite(e)) return 0;
+
+    double diff = fabs(a - e);
+    double scale = fabs(a) > fabs(e) ? fabs(a) : fabs(e);
+    return diff <= cmp->spec.abs_epsilon || diff <= cmp->spec.rel_epsilon * scale;
+}
+
+/**
+ * @brief Keeps the first MAX_COMPARE_TOKEN bytes of a token for the numeric check.
+ */
+void append_token_bytes(char *token, int *length, const char *data, size_t len) {
+    if (*length < MAX_COMPARE_TOKEN) {
+        size_t room = MAX_COMPARE_TOKEN - *length;
+        memcpy(token + *length, data, len < room ? len : room);
+    }
+    *length += (len > MAX_COMPARE_TOKEN) ? MAX_COMPARE_TOKEN : (int)len;
+}
+
+/**
+ * @brief Marks the current token as different; only numeric mode waits for the whole token.
+ */
+void comparator_token_differs(OutputComparator *cmp) {
+    cmp->token_equal = 0;
+    if (cmp->spec.mode != COMPARE_NUMERIC) cmp->mismatch_offset = cmp->token_offset;
+}
+
+void comparator_begin_token(OutputComparator *cmp) {
+    int expected_newlines = comparator_skip_expected_space(cmp);
+    if (expected_newlines < 0 ||
+        (cmp->spec.mode == COMPARE_WHITESPACE && expected_newlines != cmp->newlines)) {
+        cmp->mismatch_offset = cmp->offset; // Extra output, or a different line layout
+        return;
+    }
+    cmp->in_token = 1;
+    cmp->token_offset = cmp->offset;
+    cmp->token_equal = 1;
+    cmp->expected_token_ended = 0;
+    cmp->actual_length = 0;
+    cmp->expected_length = 0;
+    cmp->newlines = 0;
+}
+
+/**
+ * @brief Matches a run of actual token bytes against the expected token.
+ */
+void comparator_match_token(OutputComparator *cmp, const char *data, size_t len) {
+    append_token_bytes(cmp->actual_token, &cmp->actual_length, data, len);
+
+    while (len > 0 && !cmp->expected_token_ended) {
+        if (!comparator_fill_expected(cmp)) {
+            cmp->expected_token_ended = 1;
+            break;
+        }
+        const char *p = cmp->expected_buffer + cmp->expected_pos;
+        size_t available = byte_kernels.find_space(p, cmp->expected_fill - cmp->expected_pos);
+        if (available == 0) {
+            cmp->expected_token_ended = 1;
+            break;
+        }
+
+        size_t n = (available < len) ? available : len;
+        if (cmp->token_equal && byte_kernels.first_mismatch(data, p, n) < n) {
+            comparator_token_differs(cmp);
+        }
+        append_token_bytes(cmp->expected_token, &cmp->expected_length, p, n);
+        cmp->expected_pos += n;
+        data += n;
+        len -= n;
+    }
+
+    // The expected token is shorter
+    if (len > 0 && cmp->token_equal) comparator_token_differs(cmp);
+}
+
+void comparator_end_token(OutputComparator *cmp) {
+    // The rest of a longer expected token
+    while (!cmp->expected_token_ended && comparator_fill_expected(cmp)) {
+        const char *p = cmp->expected_buffer + cmp->expected_pos;
+        size_t available = byte_kernels.find_space(p, cmp->expected_fill - cmp->expected_pos);
+        if (available > 0 && cmp->token_equal) comparator_token_differs(cmp);
+        append_token_bytes(cmp->expected_token, &cmp->expected_length, p, available);
+        cmp->expected_pos += available;
+        if (cmp->expected_pos < cmp->expected_fill) break;
+    }
+    cmp->in_token = 0;
+
+    if (!cmp->token_equal && !(cmp->spec.mode == COMPARE_NUMERIC && numeric_tokens_match(cmp))) {
+        cmp->mismatch_offset = cmp->token_offset;
+    }
+}
+
+/**
+ * @brief Exact mode: byte comparison where only trailing whitespace may differ.
+ *
+ * Differing bytes are a definite mismatch unless both are whitespace and the expected
+ * output has nothing but whitespace left; then the actual output may only add whitespace.
+ */
+void comparator_feed_exact(OutputComparator *cmp, const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len && cmp->mismatch_offset < 0) {
+        if (cmp->exact_tail) {
+            if (byte_kernels.skip_space(data + i, len - i) < len - i) {
+                cmp->mismatch_offset = cmp->tail_offset;
+            }
+            cmp->offset += len - i;
+            return;
+        }
+        if (!comparator_fill_expected(cmp)) {
+            cmp->exact_tail = 1;
+            cmp->tail_offset = cmp->offset;
+            continue;
+        }
+
+        const char *p = cmp->expected_buffer + cmp->expected_pos;
+        size_t available = cmp->expected_fill - cmp->expected_pos;
+        size_t n = (available < len - i) ? available : len - i;
+        size_t same = byte_kernels.first_mismatch(data + i, p, n);
+        i += same;
+        cmp->offset += same;
+        cmp->expected_pos += same;
+        if (same == n) continue;
+
+        if (!IS_SPACE_BYTE(data[i]) || !IS_SPACE_BYTE(p[same]) || comparator_skip_expected_space(cmp) >= 0) {
+            cmp->mismatch_offset = cmp->offset;
+            return;
+        }
+        cmp->exact_tail = 1;
+        cmp->tail_offset = cmp->offset;
+    }
+}
+
+/**
+ * @brief Consumes the next chunk of actual output.
+ *
+ * The chunk is split into whitespace and token runs; each token run is matched against
+ * the next expected token as it arrives. Only the first MAX_COMPARE_TOKEN bytes of each
+ * token are kept, for the numeric check.
+ */
+void comparator_feed(OutputComparator *cmp, const char *data, size_t len) {
+    if (cmp->spec.mode == COMPARE_EXACT) {
+        comparator_feed_exact(cmp, data, len);
+        return;
+    }
+
+    size_t i = 0;
+    while (i < len && cmp->mismatch_offset < 0) {
+        if (!cmp->in_token) {
+            size_t run = byte_kernels.skip_space(data + i, len - i);
+            cmp->newlines += byte_kernels.count_newlines(data + i, run);
+            i += run;
+            cmp->offset += run;
+            if (i == len) break;
+
+            comparator_begin_token(cmp);
+            if (cmp->mismatch_offset >= 0) break;
+        }
+
+        size_t run = byte_kernels.find_space(data + i, len - i);
+        comparator_match_token(cmp, data + i, run);
+        i += run;
+        cmp->offset += run;
+        if (i < len && cmp->mismatch_offset < 0) comparator_end_token(cmp);
+    }
+}
+
+/**
+ * @brief Feeds a spooled output file through the comparator.
+ * @return 0 on success, -1 if the file cannot be read.
+ */
+int comparator_feed_file(OutputComparator *cmp, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("open (output spool)");
+        return -1;
+    }
+
+    char chunk[1 << 16];
+    ssize_t n;
+    while (cmp->mismatch_offset < 0 && (n = read(fd, chunk, sizeof(chunk))) > 0) {
+        comparator_feed(cmp, chunk, n);
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief Ends the actual output; any expected token left over is a mismatch.
+ * @return 0 if the outputs match, 1 if not (offset in cmp->mismatch_offset).
+ */
+int comparator_finish(OutputComparator *cmp) {
+    if (cmp->mismatch_offset < 0 && cmp->in_token) comparator_end_token(cmp);
+    if (cmp->mismatch_offset < 0 && comparator_skip_expected_space(cmp) >= 0) {
+        cmp->mismatch_offset = cmp->offset; // Output ended early
+    }
+    return cmp->mismatch_offset >= 0;
+}
+
+// --- Byte Kernels ---
+
+size_t find_space_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && !IS_SPACE_BYTE(p[i])) i++;
+    return i;
+}
+
+size_t skip_space_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_SPACE_BYTE(p[i])) i++;
+    return i;
+}
+
+size_t count_newlines_scalar(const char *p, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) count += (p[i] == '\n');
+    return count;
+}
+
+size_t first_mismatch_scalar(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+#ifdef HAVE_X86_KERNELS
+/**
+ * @brief Bitmask of whitespace bytes among 16: c == ' ' or (unsigned)(c - '\t') <= 4.
+ */
+unsigned space_mask_sse2(__m128i v) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    __m128i blank = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(control, blank));
+}
+
+size_t find_space_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned mask = space_mask_sse2(_mm_loadu_si128((const __m128i *)(p + i)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + find_space_scalar(p + i, n - i);
+}
+
+size_t skip_space_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned mask = ~space_mask_sse2(_mm_loadu_si128((const __m128i *)(p + i))) & 0xFFFF;
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + skip_space_scalar(p + i, n - i);
+}
+
+size_t count_newlines_sse2(const char *p, size_t n) {
+    size_t i = 0, count = 0;
+    __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+    }
+    return count + count_newlines_scalar(p + i, n - i);
+}
+
+size_t first_mismatch_sse2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xFFFF;
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + first_mismatch_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+unsigned space_mask_avx2(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+    __m256i blank = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return (unsigned)_mm256_movemask_epi8(_mm256_or_si256(control, blank));
+}
+
+__attribute__((target("avx2")))
+size_t find_space_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned mask = space_mask_avx2(_mm256_loadu_si256((const __m256i *)(p + i)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + find_space_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+size_t skip_space_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned mask = ~space_mask_avx2(_mm256_loadu_si256((const __m256i *)(p + i)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + skip_space_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t count_newlines_avx2(const char *p, size_t n) {
+    size_t i = 0, count = 0;
+    __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+    }
+    return count + count_newlines_sse2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+size_t first_mismatch_avx2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + first_mismatch_sse2(a + i, b + i, n - i);
+}
+
+ByteKernels sse2_kernels = {"sse2", find_space_sse2, skip_space_sse2,
+                            count_newlines_sse2, first_mismatch_sse2};
+ByteKernels avx2_kernels = {"avx2", find_space_avx2, skip_space_avx2,
+                            count_newlines_avx2, first_mismatch_avx2};
+#endif
+
+/**
+ * @brief Picks the widest kernels the CPU supports. EVAL_KERNELS=scalar|sse2|avx2 caps the choice.
+ */
+void select_byte_kernels(void) {
+    byte_kernels = scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+    const char *cap = getenv("EVAL_KERNELS");
+    if (cap && strcmp(cap, "scalar") == 0) return;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) byte_kernels = sse2_kernels;
+    if (cap && strcmp(cap, "sse2") == 0) return;
+    if (__builtin_cpu_supports("avx2")) byte_kernels = avx2_kernels;
+#endif
+}
+
+/**
+ * @brief Fills buf with program-like output: numbers of varying width, spaces and newlines.
+ */
+void fill_benchmark_output(char *buf, size_t size, uint64_t seed) {
+    size_t i = 0;
+    while (i < size) {
+        uint64_t r = splitmix64_next(&seed);
+        int digits = 1 + (int)(r % 12);
+        for (int d = 0; d < digits && i < size; d++) {
+            buf[i++] = '0' + (char)((r >> (8 + 4 * d)) % 10);
+        }
+        if (i < size) buf[i++] = (r >> 60) == 0 ? '\n' : ' ';
+    }
+}
+
+/**
+ * @brief Times one kernel table over buf, returning MB/s for the tokenize and compare passes.
+ */
+void time_byte_kernels(const ByteKernels *k, const char *buf, const char *copy, size_t size,
+                       double *tokenize_mbps, double *compare_mbps) {
+    int rounds = (int)((64L << 20) / size) + 1;
+    volatile size_t sink = 0;
+    struct timespec t0, t1, t2;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < rounds; r++) {
+        size_t i = 0;
+        while (i < size) {
+            size_t run = k->skip_space(buf + i, size - i);
+            sink += k->count_newlines(buf + i, run);
+            i += run;
+            i += k->find_space(buf + i, size - i);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int r = 0; r < rounds; r++) {
+        sink += k->first_mismatch(buf, copy, size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    (void)sink;
+
+    double mb = (double)size * rounds / (1 << 20);
+    *tokenize_mbps = mb / ((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    *compare_mbps = mb / ((t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9);
+}
+
+/**
+ * @brief `bench-kernels`: throughput of each kernel set on outputs from 4 KB to max_size.
+ * @return 0 on success, -1 on a kernel disagreeing with the scalar result.
+ */
+int benchmark_byte_kernels(long max_size) {
+    const ByteKernels *tables[3];
+    int num_tables = 0;
+    tables[num_tables++] = &scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) tables[num_tables++] = &sse2_kernels;
+    if (__builtin_cpu_supports("avx2")) tables[num_tables++] = &avx2_kernels;
+#endif
+
+    char *buf = malloc(max_size), *copy = malloc(max_size);
+    if (!buf || !copy) {
+        perror("malloc for benchmark failed");
+        free(buf);
+        free(copy);
+        return -1;
+    }
+    fill_benchmark_output(buf, max_size, 42);
+    memcpy(copy, buf, max_size);
+
+    printf("⏱️  Byte kernel throughput (MB/s): tokenize = skip/count/find, compare = first_mismatch\n");
+    printf("    %10s", "size");
+    for (int t = 0; t < num_tables; t++) printf("  %9s tok  %9s cmp", tables[t]->name, tables[t]->name);
+    printf("\n");
+
+    int status = 0;
+    for (long size = 4096; size <= max_size; size *= 4) {
+        printf("    %10ld", size);
+        for (int t = 0; t < num_tables; t++) {
+            const ByteKernels *k = tables[t];
+            if (k->find_space(buf, size) != find_space_scalar(buf, size) ||
+                k->count_newlines(buf, size) != count_newlines_scalar(buf, size) ||
+                k->first_mismatch(buf, copy, size) != (size_t)size) {
+                fprintf(stderr, "\n❌ %s kernels disagree with scalar at size %ld\n", k->name, size);
+                status = -1;
+                break;
+            }
+            double tokenize, compare;
+            time_byte_kernels(k, buf, copy, size, &tokenize, &compare);
+            printf("  %13.0f  %13.0f", tokenize, compare);
+        }
+        printf("\n");
+        if (status != 0) break;
+    }
+
+    free(buf);
+    free(copy);
+    return status;
+}
+
+// --- Failure Diffs ---
+
+/**
+ * @brief Writes bytes as a JSON string literal.
+ */
+void fprint_json_string(FILE *f, const char *s, size_t len) {
+    fputc('"', f);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        switch (c) {
+        case '"': fputs("\\\"", f); break;
+        case '\\': fputs("\\\\", f); break;
+        case '\n': fputs("\\n", f); break;
+        case '\r': fputs("\\r", f); break;
+        case '\t': fputs("\\t", f); break;
+        default:
+            if (c < 0x20) fprintf(f, "\\u%04x", c);
+            else fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/**
+ * @brief Reads one line, keeping at most DIFF_MAX_LINE_LENGTH bytes of it in buf.
+ * @return 0 at end of stream.
+ */
+int read_diff_line(FILE *f, char *buf, DiffLine *line) {
+    int c;
+    line->length = 0;
+    line->text_length = 0;
+    line->hash = FNV_OFFSET_BASIS;
+    while ((c = getc(f)) != EOF && c != '\n') {
+        if (line->text_length < DIFF_MAX_LINE_LENGTH) buf[line->text_length++] = (char)c;
+        line->hash = (line->hash ^ (unsigned char)c) * FNV_PRIME;
+        line->length++;
+    }
+    line->text = buf;
+    return c != EOF || line->length > 0;
+}
+
+int diff_lines_equal(const DiffLine *a, const DiffLine *b) {
+    return a->hash == b->hash && a->length == b->length;
+}
+
+int is_blank_diff_line(const DiffLine *line) {
+    return line->length == line->text_length &&
+           byte_kernels.skip_space(line->text, line->text_length) == (size_t)line->text_length;
+}
+
+/**
+ * @brief Loads up to DIFF_MAX_LINES lines from the current stream position.
+ */
+void load_diff_side(FILE *f, long first_line, DiffSide *side) {
+    char buf[DIFF_MAX_LINE_LENGTH];
+    DiffLine line;
+    side->first_line = first_line;
+    side->num_lines = 0;
+    side->arena_used = 0;
+    side->truncated = 0;
+    while (read_diff_line(f, buf, &line)) {
+        if (side->num_lines == DIFF_MAX_LINES || side->arena_used + line.text_length > DIFF_MAX_BYTES) {
+            side->truncated = 1;
+            return;
+        }
+        char *text = side->arena + side->arena_used;
+        memcpy(text, buf, line.text_length);
+        side->arena_used += line.text_length;
+        line.text = text;
+        side->lines[side->num_lines++] = line;
+    }
+
+    // Trailing blank lines never fail a test, so they are not shown either
+    while (side->num_lines > 0 && is_blank_diff_line(&side->lines[side->num_lines - 1])) {
+        side->num_lines--;
+    }
+}
+
+/**
+ * @brief Myers' O((N+M)D) shortest edit script between two line windows.
+ * @return Number of ops written (at most n + m), or -1 if more than DIFF_MAX_EDITS edits
+ *         are needed.
+ */
+int myers_diff(const DiffLine *a, int n, const DiffLine *b, int m, DiffOp *ops) {
+    const int offset = DIFF_MAX_EDITS + 1, width = 2 * DIFF_MAX_EDITS + 3;
+    int *v = calloc(width, sizeof(int));
+    int *trace = malloc((size_t)(DIFF_MAX_EDITS + 1) * width * sizeof(int));
+    if (!v || !trace) {
+        free(v);
+        free(trace);
+        return -1;
+    }
+
+    int edits = -1;
+    for (int d = 0; d <= DIFF_MAX_EDITS && edits < 0; d++) {
+        memcpy(trace + (size_t)d * width, v, width * sizeof(int));
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && diff_lines_equal(&a[x], &b[y])) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                edits = d;
+                break;
+            }
+        }
+    }
+
+    int num_ops = 0;
+    if (edits >= 0) {
+        // Walk back through the saved frontiers, emitting ops in reverse
+        int x = n, y = m;
+        for (int d = edits; d >= 0; d--) {
+            const int *prev = trace + (size_t)d * width;
+            int k = x - y;
+            int prev_k = (d == 0) ? 0 : (k == -d || (k != d && prev[offset + k - 1] < prev[offset + k + 1]))
+                ? k + 1 : k - 1;
+            int prev_x = (d == 0) ? 0 : prev[offset + prev_k];
+            int prev_y = prev_x - prev_k;
+            while (x > prev_x && y > prev_y) {
+                x--;
+                y--;
+                ops[num_ops++] = (DiffOp){' ', x, y};
+            }
+            if (d == 0) break;
+            if (prev_k == k + 1) {
+                ops[num_ops++] = (DiffOp){'+', x, --y};
+            } else {
+                ops[num_ops++] = (DiffOp){'-', --x, y};
+            }
+        }
+        for (int i = 0; i < num_ops / 2; i++) {
+            DiffOp tmp = ops[i];
+            ops[i] = ops[num_ops - 1 - i];
+            ops[num_ops - 1 - i] = tmp;
+        }
+    }
+
+    free(v);
+    free(trace);
+    return edits >= 0 ? num_ops : -1;
+}
+
+/**
+ * @brief Opens the expected output of a test: the literal, or the memoized reference run.
+ */
+FILE *open_expected_output(const DynamicTestCase *tc) {
+    if (!is_generated_test(tc)) return open_string_stream(tc->expected_output);
+
+    MemoEntry *reference = memo_lookup(run_memo_key(reference_hash, tc));
+    return (reference && reference->status == 0) ? fopen(reference->output_path, "r") : NULL;
+}
+
+/**
+ * @brief Skips lines up to the first differing one, leaving DIFF_CONTEXT_LINES of context.
+ * @return 1-based line number both streams are now positioned at.
+ */
+long skip_common_lines(FILE *expected, FILE *actual) {
+    char buf_e[DIFF_MAX_LINE_LENGTH], buf_a[DIFF_MAX_LINE_LENGTH];
+    DiffLine line_e, line_a;
+    long common = 0;
+    for (;;) {
+        int more_e = read_diff_line(expected, buf_e, &line_e);
+        int more_a = read_diff_line(actual, buf_a, &line_a);
+        if (!more_e || !more_a || !diff_lines_equal(&line_e, &line_a)) break;
+        common++;
+    }
+
+    long skip = common > DIFF_CONTEXT_LINES ? common - DIFF_CONTEXT_LINES : 0;
+    rewind(expected);
+    rewind(actual);
+    for (long i = 0; i < skip; i++) {
+        read_diff_line(expected, buf_e, &line_e);
+        read_diff_line(actual, buf_a, &line_a);
+    }
+    return skip + 1;
+}
+
+void append_hunk_line(FILE *out, int *count, char op, const DiffLine *line) {
+    if (*count > 0) fputs(", ", out);
+    char text[DIFF_MAX_LINE_LENGTH + 1];
+    text[0] = op;
+    memcpy(text + 1, line->text, line->text_length);
+    fprint_json_string(out, text, line->text_length + 1);
+    (*count)++;
+}
+
+/**
+ * @brief Renders the edit script as at most DIFF_MAX_HUNKS hunks with context.
+ * @return 1 if changes were left out.
+ */
+int write_diff_hunks(FILE *out, const DiffSide *expected, const DiffSide *actual,
+                     const DiffOp *ops, int num_ops) {
+    int i = 0, hunks = 0;
+    while (i < num_ops) {
+        int change = i;
+        while (change < num_ops && ops[change].op == ' ') change++;
+        if (change == num_ops) return 0;
+        if (hunks == DIFF_MAX_HUNKS) return 1;
+
+        // Extend while the next change is within two contexts' worth of common lines
+        int start = change - DIFF_CONTEXT_LINES > i ? change - DIFF_CONTEXT_LINES : i;
+        int last_change = change;
+        for (int j = change + 1; j < num_ops && j <= last_change + 2 * DIFF_CONTEXT_LINES; j++) {
+            if (ops[j].op != ' ') last_change = j;
+        }
+        int end = last_change + DIFF_CONTEXT_LINES + 1 < num_ops ? last_change + DIFF_CONTEXT_LINES + 1 : num_ops;
+
+        fprintf(out, "%s{\"expected_line\": %ld, \"actual_line\": %ld, \"lines\": [",
+                hunks ? ", " : "", expected->first_line + ops[start].a, actual->first_line + ops[start].b);
+        int count = 0;
+        for (int j = start; j < end && count < DIFF_MAX_HUNK_LINES; j++) {
+            append_hunk_line(out, &count, ops[j].op,
+                             ops[j].op == '+' ? &actual->lines[ops[j].b] : &expected->lines[ops[j].a]);
+        }
+        fprintf(out, "]}");
+        if (end - start > DIFF_MAX_HUNK_LINES) return 1;
+        hunks++;
+        i = end;
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds a bounded line diff of a wrong answer as a JSON object.
+ *
+ * Common leading lines are skipped by streaming both outputs, then at most DIFF_MAX_LINES
+ * lines per side are diffed with a depth-limited Myers search. Memory is fixed by the
+ * DIFF_* limits whatever the output sizes.
+ * @return malloc'd JSON text, or NULL if an output is unavailable.
+ */
+char *build_failure_diff(int index, const MemoEntry *actual_run) {
+    const DynamicTestCase *tc = &suite->tests[index];
+    FILE *expected = open_expected_output(tc);
+    FILE *actual = actual_run->output_path[0] ? fopen(actual_run->output_path, "r") : fopen("/dev/null", "r");
+    DiffSide sides[2] = {0};
+    DiffOp *ops = NULL;
+    char *json = NULL;
+    size_t json_size = 0;
+    FILE *out = NULL;
+
+    for (int s = 0; s < 2; s++) {
+        sides[s].arena = malloc(DIFF_MAX_BYTES);
+        sides[s].lines = malloc(DIFF_MAX_LINES * sizeof(DiffLine));
+    }
+    ops = malloc((2 * DIFF_MAX_LINES + 1) * sizeof(DiffOp));
+    if (!expected || !actual || !ops || !sides[0].arena || !sides[0].lines ||
+        !sides[1].arena || !sides[1].lines || !(out = open_memstream(&json, &json_size))) {
+        goto done;
+    }
+
+    long first_line = skip_common_lines(expected, actual);
+    load_diff_side(expected, first_line, &sides[0]);
+    load_diff_side(actual, first_line, &sides[1]);
+
+    fprintf(out, "{\"test\": %d, \"description\": ", index + 1);
+    fprint_json_string(out, tc->description, strlen(tc->description));
+    fprintf(out, ", \"expected_from\": \"%s\", \"actual_complete\": %s, \"hunks\": [",
+            is_generated_test(tc) ? "reference" : "literal",
+            actual_run->status == RUN_ABORTED ? "false" : "true");
+
+    // A much longer side (often the expected one against a killed run) would only add
+    // deletions past the search depth; keep what can still be aligned
+    for (int s = 0; s < 2; s++) {
+        int limit = sides[1 - s].num_lines + DIFF_MAX_EDITS / 2;
+        if (sides[s].num_lines > limit) {
+            sides[s].num_lines = limit;
+            sides[s].truncated = 1;
+        }
+    }
+
+    int truncated = sides[0].truncated || sides[1].truncated;
+    int num_ops = myers_diff(sides[0].lines, sides[0].num_lines, sides[1].lines, sides[1].num_lines, ops);
+    if (num_ops >= 0) {
+        truncated |= write_diff_hunks(out, &sides[0], &sides[1], ops, num_ops);
+    } else {
+        // Too different to align: show the start of both windows as one replaced block
+        int count = 0;
+        fprintf(out, "{\"expected_line\": %ld, \"actual_line\": %ld, \"lines\": [", first_line, first_line);
+        for (int j = 0; j < sides[0].num_lines && count < DIFF_MAX_HUNK_LINES / 2; j++) {
+            append_hunk_line(out, &count, '-', &sides[0].lines[j]);
+        }
+        for (int j = 0; j < sides[1].num_lines && count < DIFF_MAX_HUNK_LINES; j++) {
+            append_hunk_line(out, &count, '+', &sides[1].lines[j]);
+        }
+        fprintf(out, "]}");
+        truncated = 1;
+    }
+    fprintf(out, "], \"truncated\": %s}", truncated ? "true" : "false");
+
+done:
+    if (out && fclose(out) != 0) {
+        free(json);
+        json = NULL;
+    }
+    if (expected) fclose(expected);
+    if (actual) fclose(actual);
+    for (int s = 0; s < 2; s++) {
+        free(sides[s].arena);
+        free(sides[s].lines);
+    }
+    free(ops);
+    return json;
+}
+
+// --- Checker Programs ---
+
+/**
+ * @brief Compiles the suite's checker on first use.
+ * @return 0 on success, -1 on failure.
+ */
+int ensure_checker_compiled(void) {
+    if (checker_executable_path[0] != '\0') return 0;
+
+    char checker_path[MAX_PATH_SIZE];
+    snprintf(checker_path, sizeof(checker_path), "%s/checker_program", temp_dir_path);
+    if (compile_auxiliary_program(suite->checker_source, checker_path) != 0) {
+        fprintf(stderr, "❌ Failed to compile checker %s\n", suite->checker_source);
+        return -1;
+    }
+    snprintf(checker_executable_path, sizeof(checker_executable_path), "%s", checker_path);
+    return 0;
+}
+
+/**
+ * @brief Creates an anonymous in-memory file holding data, positioned at its start.
+ * @return The file descriptor, or -1 on failure.
+ */
+int create_data_memfd(const char *name, const char *data, size_t len) {
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd == -1) {
+        perror("memfd_create");
+        return -1;
+    }
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            perror("write (memfd)");
+            close(fd);
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/**
+ * @brief Names a memfd by a path any process can open, so code that takes paths needs no change.
+ *
+ * Uses the evaluator's pid rather than /proc/self, which would mean the child in a child.
+ * Only the evaluator itself can map such a path back to its fd (memfd_path_fd).
+ */
+void memfd_path(int fd, char *path, size_t path_size) {
+    snprintf(path, path_size, "/proc/%d/fd/%d", (int)getpid(), fd);
+}
+
+/**
+ * @brief Returns the descriptor behind a memfd_path() path, or -1 for an ordinary path.
+ */
+int memfd_path_fd(const char *path) {
+    int pid, fd, end = 0;
+    if (sscanf(path, "/proc/%d/fd/%d%n", &pid, &fd, &end) != 2 || path[end] != '\0') return -1;
+    return pid == (int)getpid() ? fd : -1;
+}
+
+/**
+ * @brief Discards a spooled output: closes its memfd, or removes the file.
+ */
+void remove_spool(const char *path) {
+    int fd = memfd_path_fd(path);
+    if (fd >= 0) {
+        close(fd);
+    } else {
+        remove(path);
+    }
+}
+
+/**
+ * @brief Moves every built variant into a sealed memfd and deletes the file it was linked to.
+ *
+ * Sealing makes the image immutable, so nothing the program starts can rewrite it between
+ * tests. Variant paths become memfd_path() paths: valgrind and the ASan run open them like
+ * files, and exec_program launches them with fexecve.
+ * @return 0 on success, -1 if the plain binary could not be moved.
+ */
+int load_executables_into_memfds(void) {
+    for (int v = 0; v < num_compile_variants; v++) {
+        CompileVariant *variant = &compile_variants[v];
+        if (!variant->ok) continue;
+        int file_fd = open(variant->path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        int fd = memfd_create(variant->spec->name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (file_fd == -1 || fd == -1 || fstat(file_fd, &st) != 0) {
+            perror("memfd for executable");
+            if (file_fd != -1) close(file_fd);
+            if (fd != -1) close(fd);
+            if (v == 0) return -1;
+            continue;
+        }
+        off_t copied = 0;
+        while (copied < st.st_size) {
+            ssize_t n = sendfile(fd, file_fd, NULL, st.st_size - copied);
+            if (n <= 0) break;
+            copied += n;
+        }
+        close(file_fd);
+        if (copied != st.st_size) {
+            close(fd);
+            if (v == 0) return -1;
+            continue;
+        }
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        unlink(variant->path);
+        memfd_path(fd, variant->path, sizeof(variant->path));
+    }
+    snprintf(executable_path, sizeof(executable_path), "%s", compile_variants[0].path);
+    return 0;
+}
+
+/**
+ * @brief Replaces a (forked) child with the program, via fexecve when it lives in a memfd.
+ *        Returns only on failure, with errno set.
+ * @param program_fd memfd_path_fd(program), taken in the evaluator before forking: the
+ *        child's own pid no longer matches the path.
+ */
+void exec_program(const char *program, int program_fd, char *const argv[]) {
+    extern char **environ;
+    if (program_fd >= 0) {
+        fexecve(program_fd, argv, environ);
+    } else {
+        execv(program, argv);
+    }
+}
+
+/**
+ * @brief Materializes a test's input for the checker, regenerating it for generated tests.
+ * @return A readable file descriptor positioned at the start, or -1 on failure.
+ */
+int open_checker_input(const DynamicTestCase *tc) {
+    if (!is_generated_test(tc)) return create_data_memfd("checker_input", tc->input, strlen(tc->input));
+
+    pid_t gen_pid;
+    int gen_fd = spawn_input_generator(tc, &gen_pid);
+    if (gen_fd == -1) return -1;
+
+    int fd = create_data_memfd("checker_input", "", 0);
+    char buffer[COMPARE_BUFFER_SIZE];
+    ssize_t n;
+    while (fd != -1 && (n = read(gen_fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 || write(fd, buffer, n) != n) {
+            perror("copy (generator input)");
+            close(fd);
+            fd = -1;
+        }
+    }
+    close(gen_fd);
+
+    int gen_status;
+    waitpid(gen_pid, &gen_status, 0);
+    if (fd != -1 && !(WIFEXITED(gen_status) && WEXITSTATUS(gen_status) == 0)) {
+        fprintf(stderr, "❌ Generator %s failed while preparing checker input\n", tc->generator);
+        close(fd);
+        return -1;
+    }
+    if (fd != -1) lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/**
+ * @brief Starts the checker on a finished run without waiting for it.
+ *
+ * The checker is called as `checker /dev/fd/3 /dev/fd/4 /dev/fd/5` with the test input,
+ * expected output and actual output open on fds 3, 4 and 5. Exit status 0 accepts the
+ * output, 1 rejects it, anything else is a checker failure. An optional first stdout line
+ * "<score> [comment]" gives partial credit in [0, 1]. settle_checks() collects the verdict.
+ * @return 0 once the checker is running, -1 on failure.
+ */
+int launch_checker(int index, const MemoEntry *actual) {
+    if (ensure_checker_compiled() != 0) return -1;
+
+    const DynamicTestCase *tc = &suite->tests[index];
+    int fds[3] = {-1, -1, -1};
+    int output_fd = -1;
+    pid_t pid = -1;
+
+    fds[0] = open_checker_input(tc);
+    if (is_generated_test(tc)) {
+        MemoEntry *reference = memo_lookup(run_memo_key(reference_hash, tc));
+        if (reference && reference->status == 0) fds[1] = open(reference->output_path, O_RDONLY | O_CLOEXEC);
+    } else {
+        fds[1] = create_data_memfd("checker_expected", tc->expected_output, strlen(tc->expected_output));
+    }
+    fds[2] = open(actual->output_path, O_RDONLY | O_CLOEXEC);
+    output_fd = create_data_memfd("checker_output", "", 0);
+    if (fds[0] == -1 || fds[1] == -1 || fds[2] == -1 || output_fd == -1) {
+        fprintf(stderr, "❌ Could not prepare checker files for test %d\n", index + 1);
+        goto fail;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        perror("fork for checker failed");
+        goto fail;
+    }
+
+    if (pid == 0) { // Checker process
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        setpgid(0, 0);
+        set_child_resource_limits();
+
+        // Move the files clear of 3-5 before placing them there
+        int high[3];
+        for (int k = 0; k < 3; k++) high[k] = fcntl(fds[k], F_DUPFD, 10);
+        for (int k = 0; k < 3; k++) {
+            if (high[k] == -1 || dup2(high[k], 3 + k) == -1) _exit(EXEC_FAILURE_EXIT_CODE);
+        }
+        int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd != -1) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        dup2(output_fd, STDOUT_FILENO);
+
+        execl(checker_executable_path, checker_executable_path,
+              "/dev/fd/3", "/dev/fd/4", "/dev/fd/5", (char *)NULL);
+        _exit(EXEC_FAILURE_EXIT_CODE);
+    }
+
+    setpgid(pid, pid);
+    for (int k = 0; k < 3; k++) close(fds[k]);
+    PendingCheck *check = &pending_checks[num_pending_checks++];
+    check->pid = pid;
+    check->index = index;
+    check->output_fd = output_fd;
+    check->start_ms = current_time_ms();
+    return 0;
+
+fail:
+    for (int k = 0; k < 3; k++) {
+        if (fds[k] != -1) close(fds[k]);
+    }
+    if (output_fd != -1) close(output_fd);
+    return -1;
+}
+
+/**
+ * @brief Total weight of the tests whose checker has not reported yet.
+ */
+float pending_check_weight(void) {
+    float weight = 0.0f;
+    for (int i = 0; i < num_pending_checks; i++) {
+        weight += suite->tests[pending_checks[i].index].weight;
+    }
+    return weight;
+}
+
+/**
+ * @brief Records the verdicts of finished checkers, waiting until at most max_pending remain.
+ *
+ * Checkers past TIMEOUT_SECONDS are killed and count as checker failures.
+ */
+void settle_checks(EnhancedEvalMetrics *metrics, float *passed_weight, int max_pending) {
+    for (;;) {
+        long now = current_time_ms();
+        for (int i = 0; i < num_pending_checks;) {
+            PendingCheck check = pending_checks[i];
+            int wait_status = 0;
+            int timed_out = 0;
+            pid_t done = waitpid(check.pid, &wait_status, WNOHANG);
+            if (done == 0 && now - check.start_ms > TIMEOUT_SECONDS * 1000L) {
+                kill(-check.pid, SIGKILL);
+                done = waitpid(check.pid, &wait_status, 0);
+                timed_out = 1;
+            }
+            if (done == 0 || (done == -1 && errno == EINTR)) {
+                i++;
+                continue;
+            }
+            if (done == -1) wait_status = EXEC_FAILURE_EXIT_CODE << 8; // Lost track: count as a failure
+
+            pending_checks[i] = pending_checks[--num_pending_checks];
+            finish_check(metrics, &check, wait_status, timed_out, passed_weight);
+            close(check.output_fd);
+        }
+        if (num_pending_checks <= max_pending) return;
+        usleep(1000);
+    }
+}
+
+/**
+ * @brief Turns a finished checker's exit status and stdout into the test's verdict.
+ */
+void finish_check(EnhancedEvalMetrics *metrics, const PendingCheck *check, int wait_status,
+                  int timed_out, float *passed_weight) {
+    const DynamicTestCase *tc = &suite->tests[check->index];
+    TestOutcome *outcome = &test_outcomes[check->index];
+    int interactive = suite->interactor_source[0] != '\0';
+    const char *role = interactive ? "interactor" : "checker";
+    const char *role_title = interactive ? "Interactor" : "Checker";
+
+    char output[MAX_CHECKER_OUTPUT];
+    ssize_t n = pread(check->output_fd, output, sizeof(output) - 1, 0);
+    output[n > 0 ? n : 0] = '\0';
+    output[strcspn(output, "\n")] = '\0';
+
+    int exit_code = (!timed_out && WIFEXITED(wait_status)) ? WEXITSTATUS(wait_status) : -1;
+    int accepted = exit_code == 0;
+    float score = accepted ? 1.0f : 0.0f;
+    char *comment = output;
+    char *end;
+    double printed = strtod(output, &end);
+    if (end != output && isfinite(printed) && (exit_code == 0 || exit_code == 1)) {
+        score = printed < 0.0 ? 0.0f : printed > 1.0 ? 1.0f : (float)printed;
+        comment = end;
+    }
+    while (isspace((unsigned char)*comment)) comment++;
+
+    record_test_history(tc, accepted);
+    record_verdict(metrics, check->index, accepted ? VERDICT_AC : exit_code == 1 ? VERDICT_WA : VERDICT_JE);
+    outcome->passed = accepted;
+    outcome->score = score;
+    *passed_weight += tc->weight * score;
+
+    if (accepted) {
+        printf("    Test %d: ✅ PASS (%s, score %.2f)%s%s\n", check->index + 1, role, score,
+               comment[0] ? " - " : "", comment);
+        metrics->tests_passed++;
+        return;
+    }
+
+    metrics->tests_failed++;
+    if (exit_code == 1) {
+        printf("    Test %d: ❌ FAIL - Rejected by %s (score %.2f)%s%s\n", check->index + 1, role, score,
+               comment[0] ? ": " : "", comment);
+        record_failure_detail(metrics, "Test %d (%s): Rejected by %s (score %.2f)%s%s",
+                              check->index + 1, tc->description, role, score, comment[0] ? ": " : "", comment);
+    } else if (timed_out) {
+        printf("    Test %d: ❌ FAIL - %s timed out\n", check->index + 1, role_title);
+        record_failure_detail(metrics, "Test %d (%s): %s timed out", check->index + 1, tc->description,
+                              role_title);
+    } else {
+        printf("    Test %d: ❌ FAIL - %s failed (%s %d)\n", check->index + 1, role_title,
+               WIFSIGNALED(wait_status) ? "signal" : "exit status",
+               WIFSIGNALED(wait_status) ? WTERMSIG(wait_status) : exit_code);
+        record_failure_detail(metrics, "Test %d (%s): %s failed (%s %d)", check->index + 1,
+                              tc->description, role_title, WIFSIGNALED(wait_status) ? "signal" : "exit status",
+                              WIFSIGNALED(wait_status) ? WTERMSIG(wait_status) : exit_code);
+    }
+}
+
+// --- Interactive Problems ---
+
+/**
+ * @brief Compiles the suite's interactor on first use.
+ * @return 0 on success, -1 on failure.
+ */
+int ensure_interactor_compiled(void) {
+    if (interactor_executable_path[0] != '\0') return 0;
+
+    char interactor_path[MAX_PATH_SIZE];
+    snprintf(interactor_path, sizeof(interactor_path), "%s/interactor_program", temp_dir_path);
+    if (compile_auxiliary_program(suite->interactor_source, interactor_path) != 0) {
+        fprintf(stderr, "❌ Failed to compile interactor %s\n", suite->interactor_source);
+        return -1;
+    }
+    snprintf(interactor_executable_path, sizeof(interactor_executable_path), "%s", interactor_path);
+    return 0;
+}
+
+/**
+ * @brief Runs the program against run->interactor, relaying both directions through poll().
+ *
+ * The interactor is called as `interactor /dev/fd/3 /dev/fd/4` with the test input on fd 3
+ * and its verdict report (as for a checker) on fd 4; its stdout feeds the program's stdin
+ * and the program's stdout feeds its stdin. Both share the TIMEOUT_SECONDS wall limit and
+ * the usual rlimits. Program output is hashed and limited as in a normal run, and every
+ * interactor reply answered by program output counts as one timed round trip. Once the
+ * interactor rejects the program, the program is killed.
+ * @return 0 if the program exited cleanly, -1 on timeout or execution error.
+ */
+int run_interactive_process(TestRun *run) {
+    int to_prog[2], from_prog[2], to_judge[2], from_judge[2];
+    int *pipes[4] = {to_prog, from_prog, to_judge, from_judge};
+    int opened = 0;
+
+    output_hash_init(&run->output_hash);
+    run->output_bytes = 0;
+    run->output_lines = 0;
+    run->judge_timed_out = 0;
+
+    for (; opened < 4; opened++) {
+        if (pipe2(pipes[opened], O_CLOEXEC) == -1) {
+            perror("pipe failed");
+            while (opened-- > 0) {
+                close(pipes[opened][0]);
+                close(pipes[opened][1]);
+            }
+            return -1;
+        }
+    }
+
+    // pids[0] runs the program, pids[1] the interactor
+    int program_fd = memfd_path_fd(run->program);
+    pid_t pids[2] = {-1, -1};
+    for (int p = 0; p < 2; p++) {
+        pids[p] = fork();
+        if (pids[p] == -1) {
+            perror("fork failed");
+            break;
+        }
+        if (pids[p] != 0) {
+            setpgid(pids[p], pids[p]);
+            continue;
+        }
+
+        setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+
+        // Lift everything clear of fds 0-4 first; dup2 then clears close-on-exec on the targets
+        int in = fcntl(p == 0 ? to_prog[0] : to_judge[0], F_DUPFD_CLOEXEC, 10);
+        int out = fcntl(p == 0 ? from_prog[1] : from_judge[1], F_DUPFD_CLOEXEC, 10);
+        int data = p == 1 ? fcntl(run->judge_data_fd, F_DUPFD_CLOEXEC, 10) : -1;
+        int report = p == 1 ? fcntl(run->judge_report_fd, F_DUPFD_CLOEXEC, 10) : -1;
+        if (in == -1 || out == -1 || dup2(in, STDIN_FILENO) == -1 || dup2(out, STDOUT_FILENO) == -1) {
+            _exit(EXEC_FAILURE_EXIT_CODE);
+        }
+        if (p == 1 && (data == -1 || report == -1 || dup2(data, 3) == -1 || dup2(report, 4) == -1)) {
+            _exit(EXEC_FAILURE_EXIT_CODE);
+        }
+        int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null_fd != -1) dup2(null_fd, STDERR_FILENO);
+
+        set_child_resource_limits();
+        if (p == 0) {
+            char *const argv[] = {(char *)run->program, NULL};
+            exec_program(run->program, program_fd, argv);
+        } else {
+            execl(run->interactor, run->interactor, "/dev/fd/3", "/dev/fd/4", (char *)NULL);
+        }
+        _exit(EXEC_FAILURE_EXIT_CODE);
+    }
+
+    close(to_prog[0]);
+    close(from_prog[1]);
+    close(to_judge[0]);
+    close(from_judge[1]);
+    int prog_out = from_prog[0], prog_in = to_prog[1];
+    int judge_out = from_judge[0], judge_in = to_judge[1];
+    fcntl(prog_in, F_SETFL, O_NONBLOCK);
+    fcntl(judge_in, F_SETFL, O_NONBLOCK);
+
+    int status = 0, judge_status = 0;
+    int exited = 0, judge_exited = 0;
+    if (pids[0] == -1 || pids[1] == -1) {
+        // Fork failed: take down whichever side did start
+        if (pids[0] > 0) {
+            kill(-pids[0], SIGKILL);
+            waitpid(pids[0], &status, 0);
+        }
+        close(prog_out);
+        close(prog_in);
+        close(judge_out);
+        close(judge_in);
+        return -1;
+    }
+
+    char to_judge_buf[INTERACTION_BUFFER_SIZE], to_prog_buf[INTERACTION_BUFFER_SIZE];
+    size_t to_judge_len = 0, to_judge_pos = 0, to_prog_len = 0, to_prog_pos = 0;
+    long awaiting_since = -1; // When the last reply reached the program, while it owes an answer
+    long start = current_time_ms();
+    long last_sample_ms = 0;
+
+    while (current_time_ms() - start < TIMEOUT_SECONDS * 1000 &&
+           (!exited || !judge_exited || prog_out != -1 || judge_out != -1)) {
+        // Each direction reads only once its buffer is flushed, so a slow reader throttles the writer
+        struct pollfd fds[4];
+        int nfds = 0, prog_out_idx = -1, judge_in_idx = -1, judge_out_idx = -1, prog_in_idx = -1;
+        if (prog_out != -1 && to_judge_len == 0) {
+            prog_out_idx = nfds;
+            fds[nfds++] = (struct pollfd){prog_out, POLLIN, 0};
+        }
+        if (judge_in != -1 && to_judge_len > 0) {
+            judge_in_idx = nfds;
+            fds[nfds++] = (struct pollfd){judge_in, POLLOUT, 0};
+        }
+        if (judge_out != -1 && to_prog_len == 0) {
+            judge_out_idx = nfds;
+            fds[nfds++] = (struct pollfd){judge_out, POLLIN, 0};
+        }
+        if (prog_in != -1 && to_prog_len > 0) {
+            prog_in_idx = nfds;
+            fds[nfds++] = (struct pollfd){prog_in, POLLOUT, 0};
+        }
+
+        int ready = poll(fds, nfds, 10);
+        if (ready > 0 && prog_out_idx != -1 && fds[prog_out_idx].revents) {
+            ssize_t n = read(prog_out, to_judge_buf, sizeof(to_judge_buf));
+            if (n > 0) {
+                if (awaiting_since >= 0) {
+                    long latency = current_time_us() - awaiting_since;
+                    run->round_trips++;
+                    run->total_latency_us += latency;
+                    if (latency > run->max_latency_us) run->max_latency_us = latency;
+                    awaiting_since = -1;
+                }
+                size_t lines = byte_kernels.count_newlines(to_judge_buf, n);
+                output_hash_update(&run->output_hash, to_judge_buf, n);
+                run->output_bytes += n;
+                run->output_lines += lines;
+                run->queries += lines;
+                if (run->spool_fd != -1 && write(run->spool_fd, to_judge_buf, n) != n) {
+                    perror("write (output spool)");
+                }
+                if ((run->max_output_bytes > 0 && run->output_bytes > run->max_output_bytes) ||
+                    (run->max_output_lines > 0 && run->output_lines > run->max_output_lines)) {
+                    run->output_limit_exceeded = 1;
+                    break;
+                }
+                to_judge_len = n;
+                to_judge_pos = 0;
+            } else if (n == 0 || (errno != EINTR && errno != EAGAIN) || exited) {
+                close(prog_out);
+                prog_out = -1;
+            }
+        }
+        if (ready > 0 && judge_out_idx != -1 && fds[judge_out_idx].revents) {
+            ssize_t n = read(judge_out, to_prog_buf, sizeof(to_prog_buf));
+            if (n > 0) {
+                to_prog_len = n;
+                to_prog_pos = 0;
+            } else if (n == 0 || (errno != EINTR && errno != EAGAIN) || judge_exited) {
+                close(judge_out);
+                judge_out = -1;
+            }
+        }
+        if (ready > 0 && judge_in_idx != -1 && fds[judge_in_idx].revents) {
+            ssize_t n = write(judge_in, to_judge_buf + to_judge_pos, to_judge_len - to_judge_pos);
+            if (n > 0) to_judge_pos += n;
+            if (to_judge_pos == to_judge_len || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                to_judge_len = 0; // Delivered, or the interactor stopped reading
+            }
+        }
+        if (ready > 0 && prog_in_idx != -1 && fds[prog_in_idx].revents) {
+            ssize_t n = write(prog_in, to_prog_buf + to_prog_pos, to_prog_len - to_prog_pos);
+            if (n > 0) to_prog_pos += n;
+            if (to_prog_pos == to_prog_len) {
+                to_prog_len = 0;
+                awaiting_since = current_time_us();
+            } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                to_prog_len = 0;
+            }
+        }
+
+        // Pass end-of-file on once the other side's output is drained and relayed
+        if (prog_out == -1 && to_judge_len == 0 && judge_in != -1) {
+            close(judge_in);
+            judge_in = -1;
+        }
+        if (judge_out == -1 && to_prog_len == 0 && prog_in != -1) {
+            close(prog_in);
+            prog_in = -1;
+        }
+
+        if (!exited) sample_peak_memory(run, pids[0], &last_sample_ms);
+        if (!exited && wait4(pids[0], &status, WNOHANG, &run->usage) == pids[0]) {
+            exited = 1;
+            // What is left in the pipe was written before exit; don't wait on descendants
+            if (prog_out != -1) fcntl(prog_out, F_SETFL, O_NONBLOCK);
+        }
+        if (!judge_exited && waitpid(pids[1], &judge_status, WNOHANG) == pids[1]) {
+            judge_exited = 1;
+            if (judge_out != -1) fcntl(judge_out, F_SETFL, O_NONBLOCK);
+            if (!exited && !(WIFEXITED(judge_status) && WEXITSTATUS(judge_status) == 0)) {
+                kill(-pids[0], SIGKILL); // Already rejected; nothing the program does matters now
+                run->judge_rejected_first = 1;
+            }
+        }
+    }
+
+    int fds_left[4] = {prog_out, prog_in, judge_out, judge_in};
+    for (int k = 0; k < 4; k++) {
+        if (fds_left[k] != -1) close(fds_left[k]);
+    }
+    if (!judge_exited) {
+        kill(-pids[1], SIGKILL);
+        waitpid(pids[1], &judge_status, 0);
+        run->judge_timed_out = 1;
+    }
+    run->judge_status = judge_status;
+    if (!exited) {
+        // Timeout or output limit
+        run->wall_timeout = !run->output_limit_exceeded;
+        kill(-pids[0], SIGKILL);
+        wait4(pids[0], &status, 0, &run->usage);
+        run->wait_status = status;
+        return -1;
+    }
+    run->wait_status = status;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Runs one interactive test and records the interactor's verdict.
+ *
+ * Interaction statistics are kept per test and summed into the metrics. A rejection by the
+ * interactor stands if the program was killed for it; otherwise the program itself must
+ * have exited cleanly for the interactor's verdict to count.
+ * @return JUDGE_DECIDED once the verdict is recorded; JUDGE_OUTPUT_LIMIT and -1 on
+ *         a program timeout or execution error, left to the caller as for judge_test.
+ */
+int judge_interactive_test(EnhancedEvalMetrics *metrics, int index, float *passed_weight,
+                           MemoEntry **actual_run) {
+    const DynamicTestCase *tc = &suite->tests[index];
+    memset(&interactive_run, 0, sizeof(interactive_run));
+    interactive_run.status = -1;
+    *actual_run = &interactive_run;
+    if (ensure_interactor_compiled() != 0) return -1;
+
+    TestRun run = {0};
+    run.program = executable_path;
+    run.interactor = interactor_executable_path;
+    run.input_fd = -1;
+    run.spool_fd = -1;
+    run.max_output_bytes = tc->output_limit_bytes;
+    run.max_output_lines = tc->output_limit_lines;
+    run.judge_data_fd = open_checker_input(tc);
+    run.judge_report_fd = create_data_memfd("interactor_report", "", 0);
+
+    int status = -1;
+    if (run.judge_data_fd != -1 && run.judge_report_fd != -1) {
+        status = run_test_process(&run);
+    }
+    if (run.judge_data_fd != -1) close(run.judge_data_fd);
+
+    TestOutcome *outcome = &test_outcomes[index];
+    outcome->queries = run.queries;
+    outcome->round_trips = run.round_trips;
+    outcome->mean_latency_ms = run.round_trips > 0 ? run.total_latency_us / 1000.0 / run.round_trips : 0.0;
+    outcome->max_latency_ms = run.max_latency_us / 1000.0;
+    metrics->interaction_queries += run.queries;
+    metrics->interaction_round_trips += run.round_trips;
+    metrics->interaction_latency_ms += run.total_latency_us / 1000.0;
+    if (outcome->max_latency_ms > metrics->interaction_max_latency_ms) {
+        metrics->interaction_max_latency_ms = outcome->max_latency_ms;
+    }
+    printf("      🔁 %ld queries, %ld round trips, mean latency %.3f ms, max %.3f ms\n",
+           outcome->queries, outcome->round_trips, outcome->mean_latency_ms, outcome->max_latency_ms);
+
+    interactive_run.output_hash = run.output_hash.hash;
+    interactive_run.output_length = run.output_hash.length;
+    interactive_run.output_bytes = run.output_bytes;
+    interactive_run.status = run.output_limit_exceeded ? RUN_OUTPUT_LIMIT : status;
+    interactive_run.verdict = classify_run(&run);
+    interactive_run.wait_status = run.wait_status;
+
+    // The program's own failure (a crash, say) outranks the interactor's reaction to it
+    if (run.judge_report_fd != -1 && !run.output_limit_exceeded && (status == 0 || run.judge_rejected_first)) {
+        PendingCheck check = {0, index, run.judge_report_fd, 0};
+        finish_check(metrics, &check, run.judge_status, run.judge_timed_out, passed_weight);
+        close(run.judge_report_fd);
+        return JUDGE_DECIDED;
+    }
+
+    if (run.judge_report_fd != -1) close(run.judge_report_fd);
+    return run.output_limit_exceeded ? JUDGE_OUTPUT_LIMIT : -1;
+}
+
+// --- Verdicts ---
+
+/**
+ * @brief Reads a running process's peak virtual memory (VmPeak) from /proc.
+ * @return Peak in KB, or 0 if it could not be read.
+ */
+long read_peak_memory_kb(pid_t pid) {
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    long peak_kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmPeak: %ld kB", &peak_kb) == 1) break;
+    }
+    fclose(f);
+    return peak_kb;
+}
+
+/**
+ * @brief Updates run->peak_memory_kb, at most once per MEMORY_SAMPLE_INTERVAL_MS.
+ */
+void sample_peak_memory(TestRun *run, pid_t pid, long *last_sample_ms) {
+    long now = current_time_ms();
+    if (now - *last_sample_ms < MEMORY_SAMPLE_INTERVAL_MS) return;
+    *last_sample_ms = now;
+
+    long peak_kb = read_peak_memory_kb(pid);
+    if (peak_kb > run->peak_memory_kb) run->peak_memory_kb = peak_kb;
+}
+
+/**
+ * @brief Classifies how a finished run ended, from its wait status and resource usage.
+ *
+ * RLIMIT_CPU delivers SIGXCPU (SIGKILL at the hard limit), so those, and wall timeouts that
+ * had used up the CPU budget, are TLE-CPU; other wall timeouts are TLE-wall. A process
+ * failing under RLIMIT_AS gets no signal of its own, so a crash or error exit counts as MLE
+ * only when the image could not even be loaded or the peak sampled memory came within
+ * MLE_PEAK_MARGIN_MB of the limit. VmPeak includes static arrays, so a lower peak says
+ * nothing about why the program died, and the run is RE; so is a single oversized (or
+ * doubling) request refused well below the ceiling, which leaves no trace.
+ * @return VERDICT_AC for a clean exit, otherwise the failure category.
+ */
+Verdict classify_run(const TestRun *run) {
+    if (run->output_limit_exceeded) return VERDICT_OLE;
+
+    long cpu_ms = (run->usage.ru_utime.tv_sec + run->usage.ru_stime.tv_sec) * 1000L +
+                  (run->usage.ru_utime.tv_usec + run->usage.ru_stime.tv_usec) / 1000;
+    int cpu_exhausted = cpu_ms >= CPU_TIME_LIMIT_S * 1000L;
+    int status = run->wait_status;
+
+    if (run->wall_timeout) return cpu_exhausted ? VERDICT_TLE_CPU : VERDICT_TLE_WALL;
+    if (WIFSIGNALED(status) &&
+        (WTERMSIG(status) == SIGXCPU || (WTERMSIG(status) == SIGKILL && cpu_exhausted))) {
+        return VERDICT_TLE_CPU;
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return VERDICT_AC;
+
+    long peak_kb = run->peak_memory_kb > run->usage.ru_maxrss ? run->peak_memory_kb : run->usage.ru_maxrss;
+    if ((WIFEXITED(status) && WEXITSTATUS(status) == EXEC_NO_MEMORY_EXIT_CODE) ||
+        peak_kb >= (MEMORY_LIMIT_MB - MLE_PEAK_MARGIN_MB) * 1024L) {
+        return VERDICT_MLE;
+    }
+    return VERDICT_RE;
+}
+
+/**
+ * @brief Describes why a program run failed, e.g. "Runtime error (RE): signal 11 (Segmentation fault)".
+ */
+void describe_run_failure(const MemoEntry *run, char *buffer, size_t buffer_size) {
+    int status = run->wait_status;
+    switch (run->verdict) {
+    case VERDICT_TLE_CPU:
+        snprintf(buffer, buffer_size, "Time limit exceeded (TLE-CPU): over %d s of CPU time", CPU_TIME_LIMIT_S);
+        break;
+    case VERDICT_TLE_WALL:
+        snprintf(buffer, buffer_size, "Time limit exceeded (TLE-wall): over %d s wall clock, mostly waiting",
+                 TIMEOUT_SECONDS);
+        break;
+    case VERDICT_MLE:
+        snprintf(buffer, buffer_size, "Memory limit exceeded (MLE): %d MB", MEMORY_LIMIT_MB);
+        break;
+    default:
+        if (WIFSIGNALED(status)) {
+            snprintf(buffer, buffer_size, "Runtime error (RE): signal %d (%s)", WTERMSIG(status),
+                     strsignal(WTERMSIG(status)));
+        } else {
+            snprintf(buffer, buffer_size, "Runtime error (RE): exit status %d", WEXITSTATUS(status));
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Stores a test's verdict and counts it in its category.
+ */
+void record_verdict(EnhancedEvalMetrics *metrics, int index, Verdict verdict) {
+    test_outcomes[index].verdict = verdict;
+    metrics->verdict_counts[verdict]++;
+}
+
+// --- Incremental Regrading ---
+
+/**
+ * @brief Identifies a submission build: its source text and the compiler configuration,
+ *        including the optimization profile.
+ */
+uint64_t grade_submission_key(const char *source_file) {
+    const int version = GRADE_STORE_VERSION;
+    uint64_t source_hash = hash_file_contents(source_file);
+    uint64_t hash = fnv1a_hash(FNV_OFFSET_BASIS, &version, sizeof(version));
+    hash = fnv1a_hash(hash, &source_hash, sizeof(source_hash));
+    hash = fnv1a_hash(hash, compile_profile->flags, strlen(compile_profile->flags));
+    hash = fnv1a_hash(hash, USER_COMPILER, sizeof(USER_COMPILER));
+    return fnv1a_hash(hash, USER_LINK_FLAGS, strlen(USER_LINK_FLAGS));
+}
+
+/**
+ * @brief Identifies everything besides the binary that decides a test's outcome.
+ *
+ * The input and limits (as in run_memo_key), the expected output and comparator, and
+ * judge_hash for the suite-wide reference, checker and interactor. Description, weight and
+ * the other tests are left out, so editing one test only invalidates that test.
+ */
+uint64_t grade_test_key(const DynamicTestCase *tc, uint64_t judge_hash) {
+    uint64_t input_key = run_memo_key(0, tc);
+    uint64_t hash = fnv1a_hash(FNV_OFFSET_BASIS, &input_key, sizeof(input_key));
+    hash = fnv1a_hash(hash, &judge_hash, sizeof(judge_hash));
+    hash = fnv1a_hash(hash, tc->expected_output, strlen(tc->expected_output));
+    hash = fnv1a_hash(hash, &tc->comparator.mode, sizeof(tc->comparator.mode));
+    hash = fnv1a_hash(hash, &tc->comparator.abs_epsilon, sizeof(tc->comparator.abs_epsilon));
+    return fnv1a_hash(hash, &tc->comparator.rel_epsilon, sizeof(tc->comparator.rel_epsilon));
+}
+
+/**
+ * @brief Path of the current submission's file in the grade store.
+ * @return 0 on success, -1 (with a message) if --regrade's directory is too long for it.
+ */
+int grade_store_path(char *path, size_t path_size) {
+    int n = snprintf(path, path_size, "%s/%016llx.grades", grade_store_dir, (unsigned long long)submission_key);
+    if (n < 0 || (size_t)n >= path_size) {
+        fprintf(stderr, "⚠️  Grade store path too long: %s\n", grade_store_dir);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief qsort/bsearch comparator for StoredGrade by test key.
+ */
+int compare_stored_grades(const void *a, const void *b) {
+    uint64_t ka = ((const StoredGrade *)a)->test_key, kb = ((const StoredGrade *)b)->test_key;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * @brief Reads the submission's stored grades; a missing file means nothing is stored yet.
+ *
+ * Format: an optional "quality <memory> <robustness>" line, then
+ * "<test key> <verdict> <passed> <score> <output bytes>" per graded test.
+ */
+void load_stored_grades(void) {
+    char path[MAX_PATH_SIZE];
+    if (grade_store_path(path, sizeof(path)) != 0) return;
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[256];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), f)) {
+        StoredGrade g = {0};
+        unsigned long long key;
+        int verdict;
+        if (sscanf(line, "quality %f %f", &stored_memory_score, &stored_robustness_score) == 2) {
+            stored_quality_valid = 1;
+            continue;
+        }
+        if (sscanf(line, "%llx %d %d %f %ld", &key, &verdict, &g.passed, &g.score, &g.output_bytes) != 5 ||
+            verdict < 0 || verdict >= VERDICT_COUNT) {
+            continue;
+        }
+        g.test_key = key;
+        g.verdict = (Verdict)verdict;
+        if (num_stored_grades >= capacity) {
+            capacity = 2 * capacity + 64;
+            StoredGrade *grown = realloc(stored_grades, capacity * sizeof(StoredGrade));
+            if (!grown) break;
+            stored_grades = grown;
+        }
+        stored_grades[num_stored_grades++] = g;
+    }
+    fclose(f);
+    if (num_stored_grades > 0) {
+        qsort(stored_grades, num_stored_grades, sizeof(StoredGrade), compare_stored_grades);
+    }
+}
+
+/**
+ * @brief Looks up a stored grade by test key.
+ */
+StoredGrade *find_stored_grade(uint64_t key) {
+    if (num_stored_grades == 0) return NULL;
+    StoredGrade probe = {0};
+    probe.test_key = key;
+    return bsearch(&probe, stored_grades, num_stored_grades, sizeof(StoredGrade), compare_stored_grades);
+}
+
+/**
+ * @brief Loads the grade store for this submission and marks the selected tests it answers.
+ * @return Number of selected tests that still have to run.
+ */
+int mark_stored_tests(const char *source_file) {
+    submission_key = grade_submission_key(source_file);
+    load_stored_grades();
+
+    uint64_t judge_hash = FNV_OFFSET_BASIS;
+    const char *judges[] = {suite->reference_source, suite->checker_source, suite->interactor_source};
+    for (int k = 0; k < 3; k++) {
+        uint64_t source_hash = judges[k][0] ? hash_file_contents(judges[k]) : 0;
+        judge_hash = fnv1a_hash(judge_hash, &source_hash, sizeof(source_hash));
+    }
+
+    int selected = 0, to_run = 0;
+    for (int i = 0; i < suite->num_tests; i++) {
+        if (!test_outcomes[i].selected) continue;
+        test_outcomes[i].grade_key = grade_test_key(&suite->tests[i], judge_hash);
+        test_outcomes[i].from_store = find_stored_grade(test_outcomes[i].grade_key) != NULL;
+        to_run += !test_outcomes[i].from_store;
+        selected++;
+    }
+    printf("♻️  Grade store: %d of %d tests unchanged, %d to run\n\n", selected - to_run, selected, to_run);
+    return to_run;
+}
+
+/**
+ * @brief Counts a stored outcome as if the test had just been judged.
+ */
+void apply_stored_grade(EnhancedEvalMetrics *metrics, int index, float *passed_weight) {
+    const DynamicTestCase *tc = &suite->tests[index];
+    const StoredGrade *g = find_stored_grade(test_outcomes[index].grade_key);
+    TestOutcome *outcome = &test_outcomes[index];
+
+    outcome->passed = g->passed;
+    outcome->score = g->score;
+    outcome->output_limit_exceeded = g->verdict == VERDICT_OLE;
+    outcome->output_bytes = g->output_bytes;
+    record_verdict(metrics, index, g->verdict);
+    *passed_weight += tc->weight * g->score;
+    metrics->stored_results++;
+
+    if (g->passed) {
+        metrics->tests_passed++;
+        return;
+    }
+    metrics->tests_failed++;
+    if (g->verdict == VERDICT_OLE) metrics->output_limit_exceeded++;
+    record_failure_detail(metrics, "Test %d (%s): %s (unchanged since the stored grade)",
+                          index + 1, tc->description, verdict_names[g->verdict]);
+}
+
+/**
+ * @brief Writes this grading's outcomes back to the store, keeping entries for other tests.
+ *
+ * Judge errors are not stored, so they are retried next time. Tests with identical
+ * definitions share one entry. The file is replaced via a temporary one, as for --history.
+ */
+void save_stored_grades(const EnhancedEvalMetrics *metrics) {
+    StoredGrade *grades = malloc((num_stored_grades + suite->num_tests + 1) * sizeof(StoredGrade));
+    if (!grades) {
+        perror("malloc for grade store failed");
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < suite->num_tests; i++) {
+        const TestOutcome *outcome = &test_outcomes[i];
+        if (!outcome->selected || outcome->verdict == VERDICT_JE) continue;
+        StoredGrade *old = find_stored_grade(outcome->grade_key);
+        if (old) old->superseded = 1;
+        grades[n++] = (StoredGrade){outcome->grade_key, outcome->verdict, outcome->passed,
+                                    outcome->score, outcome->output_bytes, 0};
+    }
+    for (int i = 0; i < num_stored_grades; i++) {
+        if (!stored_grades[i].superseded) grades[n++] = stored_grades[i];
+    }
+    if (n > 0) qsort(grades, n, sizeof(StoredGrade), compare_stored_grades);
+
+    char path[MAX_PATH_SIZE], tmp_path[MAX_PATH_SIZE + 32];
+    if (grade_store_path(path, sizeof(path)) != 0) {
+        free(grades);
+        return;
+    }
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        perror("fopen (grade store)");
+        free(grades);
+        return;
+    }
+
+    if (!metrics->quality_checks_skipped) {
+        fprintf(f, "quality %.1f %.1f\n", metrics->memory_score, metrics->robustness_score);
+    } else if (stored_quality_valid) {
+        fprintf(f, "quality %.1f %.1f\n", stored_memory_score, stored_robustness_score);
+    }
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && grades[i].test_key == grades[i - 1].test_key) continue;
+        fprintf(f, "%016llx %d %d %g %ld\n", (unsigned long long)grades[i].test_key, (int)grades[i].verdict,
+                grades[i].passed, grades[i].score, grades[i].output_bytes);
+    }
+    free(grades);
+
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0) {
+        perror("saving grade store");
+        remove(tmp_path);
+    }
+}
+
+// --- Batch Grading ---
+
+/**
+ * @brief Reduces a source to what the compiler sees, so copies differing only in comments or
+ *        layout compare equal.
+ *
+ * Comments and whitespace runs become a single space, and indentation and trailing whitespace
+ * go away, so re-wrapped code matches too. Newlines are kept only around preprocessor
+ * directives, which end at them. Spaces between tokens are kept, since "a+ +b" and "a++b"
+ * differ. String and character literals are copied untouched.
+ * @return A malloc'd buffer (not NUL-terminated), or NULL if the file cannot be read.
+ */
+char *normalize_source(const char *path, size_t *length) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(size > 0 ? size : 1);
+    char *out = malloc(size > 0 ? size : 1);
+    if (!text || !out || (size > 0 && fread(text, 1, size, f) != (size_t)size)) {
+        fclose(f);
+        free(text);
+        free(out);
+        return NULL;
+    }
+    fclose(f);
+
+    size_t n = 0;
+    char pending = 0; // Whitespace seen since the last copied byte: ' ' or '\n'
+    int line_start = 1, in_directive = 0;
+    for (long i = 0; i < size; i++) {
+        char c = text[i];
+        if (c == '\n') {
+            if (in_directive && !(i > 0 && text[i - 1] == '\\')) {
+                in_directive = 0;
+                pending = '\n';
+            } else if (!pending) {
+                pending = ' ';
+            }
+            line_start = 1;
+            continue;
+        }
+        if (IS_SPACE_BYTE(c)) {
+            if (!pending) pending = ' ';
+            continue;
+        }
+        if (c == '/' && i + 1 < size && text[i + 1] == '/') {
+            while (i + 1 < size && text[i + 1] != '\n') {
+                i += (text[i + 1] == '\\' && i + 2 < size && text[i + 2] == '\n') ? 2 : 1;
+            }
+            if (!pending) pending = ' ';
+            continue;
+        }
+        if (c == '/' && i + 1 < size && text[i + 1] == '*') {
+            for (i += 2; i + 1 < size && !(text[i] == '*' && text[i + 1] == '/'); i++) {}
+            i++;
+            if (!pending) pending = ' ';
+            continue;
+        }
+
+        if (line_start && c == '#') {
+            in_directive = 1;
+            pending = '\n';
+        }
+        line_start = 0;
+        if (pending && n > 0 && (pending == '\n' || out[n - 1] != '\n')) out[n++] = pending;
+        pending = 0;
+        out[n++] = c;
+        if (c == '"' || c == '\'') {
+            // Copy the literal up to its closing quote; escapes are copied with what they escape
+            while (++i < size && text[i] != c && text[i] != '\n') {
+                out[n++] = text[i];
+                if (text[i] == '\\' && i + 1 < size) out[n++] = text[++i];
+            }
+            if (i < size) out[n++] = text[i];
+        }
+    }
+    free(text);
+    *length = n;
+    return out;
+}
+
+/**
+ * @brief True when a normalized source has an #include (or #import) not of the <...> form.
+ *
+ * Such a header is looked up next to the source, so two identical texts in different
+ * directories may still compile to different programs.
+ */
+int has_local_include(const char *normalized, size_t length) {
+    for (size_t k = 0; k < length; k++) {
+        if (normalized[k] != '#' || (k > 0 && normalized[k - 1] != '\n')) continue;
+        size_t p = k + 1;
+        if (p < length && normalized[p] == ' ') p++;
+        size_t word = p;
+        while (p < length && isalpha((unsigned char)normalized[p])) p++;
+        if ((p - word == 7 && memcmp(normalized + word, "include", 7) == 0) ||
+            (p - word == 6 && memcmp(normalized + word, "import", 6) == 0)) {
+            if (p < length && normalized[p] == ' ') p++;
+            if (p >= length || normalized[p] != '<') return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Names a submission's result file after its path, so student1/main.c and
+ *        student2/main.c do not collide.
+ *
+ * '/' becomes '_', and '_' and '%' are escaped as %5F and %25, so no two paths share a name
+ * (a_b/c.c is "a%5Fb_c.c", a/b_c.c is "a_b%5Fc.c").
+ * @return 0 on success, -1 if the name does not fit.
+ */
+int batch_result_path(const char *results_dir, const char *source, char *path, size_t path_size) {
+    char name[MAX_PATH_SIZE];
+    size_t k = 0;
+    for (const char *p = source; *p; p++) {
+        if (k + 4 > sizeof(name)) return -1;
+        if (*p == '_' || *p == '%') {
+            k += snprintf(name + k, sizeof(name) - k, "%%%02X", (unsigned char)*p);
+        } else {
+            name[k++] = *p == '/' ? '_' : *p;
+        }
+    }
+    name[k] = '\0';
+    int n = snprintf(path, path_size, "%s/%s.json", results_dir, name);
+    return n >= 0 && (size_t)n < path_size ? 0 : -1;
+}
+
+/**
+ * @brief Grades many submissions against one suite, evaluating each distinct source once.
+ *
+ * Sources are grouped by normalize_source(), except ones with a local #include, whose headers
+ * may differ from directory to directory. The first of each group is evaluated by a child
+ * evaluator (this binary, with the pass-through options) and its results are copied into every
+ * other member's file, marked "shared_result". The representative's file lists its duplicates.
+ * A batch_summary.json in results_dir records the groups.
+ * @return 0 if every representative produced results, -1 otherwise.
+ */
+int run_batch(const char *suite_file, const char *results_dir, int num_sources, char **sources,
+              int num_options, char **options) {
+    if (mkdir(results_dir, 0700) != 0 && errno != EEXIST) {
+        perror("mkdir (batch results)");
+        return -1;
+    }
+    BatchSubmission *subs = calloc(num_sources, sizeof(BatchSubmission));
+    if (!subs) return -1;
+
+    // Every source gets its own results file, so the names are settled before any work starts
+    for (int i = 0; i < num_sources; i++) {
+        char result_path[MAX_PATH_SIZE * 2];
+        if (batch_result_path(results_dir, sources[i], result_path, sizeof(result_path)) != 0) {
+            fprintf(stderr, "❌ Path too long for a results file name: %s\n", sources[i]);
+            free(subs);
+            return -1;
+        }
+        for (int j = 0; j < i; j++) {
+            if (strcmp(sources[j], sources[i]) == 0) {
+                fprintf(stderr, "❌ %s is listed twice\n", sources[i]);
+                free(subs);
+                return -1;
+            }
+        }
+    }
+
+    int num_groups = 0;
+    for (int i = 0; i < num_sources; i++) {
+        subs[i].source = sources[i];
+        subs[i].representative = i;
+        subs[i].normalized = normalize_source(sources[i], &subs[i].length);
+        if (!subs[i].normalized) {
+            fprintf(stderr, "⚠️  Cannot read %s; it is evaluated on its own\n", sources[i]);
+        } else if (has_local_include(subs[i].normalized, subs[i].length)) {
+            printf("ℹ️  %s includes a local header; it is evaluated on its own\n", sources[i]);
+            free(subs[i].normalized);
+            subs[i].normalized = NULL;
+        } else {
+            subs[i].hash = fnv1a_hash(FNV_OFFSET_BASIS, subs[i].normalized, subs[i].length);
+            for (int j = 0; j < i; j++) {
+                if (subs[j].representative == j && subs[j].normalized && subs[j].hash == subs[i].hash &&
+                    subs[j].length == subs[i].length &&
+                    memcmp(subs[j].normalized, subs[i].normalized, subs[i].length) == 0) {
+                    subs[i].representative = j;
+                    break;
+                }
+            }
+        }
+        num_groups += subs[i].representative == i;
+    }
+    printf("📦 Batch: %d submissions in %d distinct groups (%d evaluations saved)\n\n", num_sources,
+           num_groups, num_sources - num_groups);
+
+    json_object *summary = json_object_new_object();
+    json_object *groups = json_object_new_array();
+    int failures = 0;
+    for (int i = 0; i < num_sources; i++) {
+        if (subs[i].representative != i) continue;
+        char result_path[MAX_PATH_SIZE * 2];
+        batch_result_path(results_dir, subs[i].source, result_path, sizeof(result_path));
+        remove(result_path);
+
+        printf("▶️  Evaluating %s\n", subs[i].source);
+        Command command;
+        command_init(&command, "/proc/self/exe");
+        for (int k = 0; k < num_options; k++) command_add(&command, options[k]);
+        command_add(&command, "--output");
+        command_add(&command, result_path);
+        command_add(&command, subs[i].source);
+        command_add(&command, suite_file);
+        int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        int status = run_command(&command, NULL, null_fd, -1, NULL);
+        if (null_fd >= 0) close(null_fd);
+
+        json_object *result = json_object_from_file(result_path);
+        json_object *group = json_object_new_object();
+        json_object *members = json_object_new_array();
+        json_object_object_add(group, "representative", json_object_new_string(subs[i].source));
+        json_object_object_add(group, "exit_status",
+                               json_object_new_int(status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1));
+        if (!result) {
+            fprintf(stderr, "❌ No results for %s\n", subs[i].source);
+            failures++;
+        }
+
+        // Members get the representative's results under their own name
+        for (int j = i + 1; j < num_sources; j++) {
+            if (subs[j].representative != i) continue;
+            json_object_array_add(members, json_object_new_string(subs[j].source));
+            if (!result) continue;
+            json_object *copy = json_object_from_file(result_path);
+            json_object_object_add(copy, "source_file", json_object_new_string(subs[j].source));
+            json_object_object_add(copy, "shared_result", json_object_new_boolean(1));
+            json_object_object_add(copy, "shared_from", json_object_new_string(subs[i].source));
+            char member_path[MAX_PATH_SIZE * 2];
+            batch_result_path(results_dir, subs[j].source, member_path, sizeof(member_path));
+            if (json_object_to_file_ext(member_path, copy, JSON_C_TO_STRING_PRETTY) != 0) {
+                fprintf(stderr, "❌ Failed to write %s\n", member_path);
+                failures++;
+            }
+            json_object_put(copy);
+        }
+        if (result) {
+            json_object_object_add(result, "source_file", json_object_new_string(subs[i].source));
+            json_object_object_add(result, "shared_result", json_object_new_boolean(0));
+            json_object_object_add(result, "duplicate_submissions", json_object_get(members));
+            json_object_to_file_ext(result_path, result, JSON_C_TO_STRING_PRETTY);
+            json_object_put(result);
+        }
+        printf("    %s %s%s\n", result ? "✅" : "❌", result_path,
+               json_object_array_length(members) ? " (shared with duplicates)" : "");
+        json_object_object_add(group, "members", members);
+        json_object_array_add(groups, group);
+    }
+
+    json_object_object_add(summary, "submissions", json_object_new_int(num_sources));
+    json_object_object_add(summary, "distinct_submissions", json_object_new_int(num_groups));
+    json_object_object_add(summary, "evaluations_saved", json_object_new_int(num_sources - num_groups));
+    json_object_object_add(summary, "groups", groups);
+    char summary_path[MAX_PATH_SIZE * 2];
+    snprintf(summary_path, sizeof(summary_path), "%s/batch_summary.json", results_dir);
+    if (json_object_to_file_ext(summary_path, summary, JSON_C_TO_STRING_PRETTY) != 0) {
+        fprintf(stderr, "❌ Failed to write %s\n", summary_path);
+        failures++;
+    }
+    json_object_put(summary);
+
+    for (int i = 0; i < num_sources; i++) free(subs[i].normalized);
+    free(subs);
+    printf("\n🎉 Batch complete. Results written to %s\n", results_dir);
+    return failures == 0 ? 0 : -1;
+}
+
+// --- Self-Checks ---
+
+/**
+ * @brief Reports one self-check case.
+ * @return 0 if it held, 1 if not.
+ */
+int self_check(int ok, const char *group, const char *name) {
+    if (!ok) printf("    ❌ %s: %s\n", group, name);
+    return !ok;
+}
+
+/**
+ * @brief Writes text to dir/name for a self-check, storing the path in path.
+ * @return 0 on success, -1 on failure.
+ */
+int write_self_check_file(const char *dir, const char *name, const char *text, char *path, size_t path_size) {
+    int n = snprintf(path, path_size, "%s/%s", dir, name);
+    if (n < 0 || (size_t)n >= path_size) return -1;
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Merges two overlapping partials: test 2 is in both, with different outcomes.
+ * @return Number of failed cases.
+ */
+int self_check_merge(const char *dir) {
+    static const char *partial_a =
+        "{\"suite_tests\": 3, \"shard\": \"1/2\", \"early_stop\": \"reached\", \"target_score\": 50.0,\n"
+        " \"weighted_score_bounds\": [50.0, 100.0], \"output_limit_exceeded\": 0,\n"
+        " \"verdicts\": {\"AC\": 1, \"WA\": 1}, \"interaction\": {\"queries\": 9, \"round_trips\": 9},\n"
+        " \"failed_test_details\": [\"Test 2 (b): wrong\"], \"failed_test_diffs\": [{\"test\": 2}],\n"
+        " \"test_results\": [\n"
+        "  {\"test\": 1, \"passed\": true, \"verdict\": \"AC\", \"weight\": 1, \"queries\": 3, \"round_trips\": 2,"
+        " \"mean_latency_ms\": 1.0, \"max_latency_ms\": 1.5},\n"
+        "  {\"test\": 2, \"passed\": false, \"verdict\": \"WA\", \"weight\": 1, \"queries\": 1, \"round_trips\": 2,"
+        " \"mean_latency_ms\": 3.0, \"max_latency_ms\": 4.0}]}\n";
+    static const char *partial_b =
+        "{\"suite_tests\": 3, \"shard\": \"2/2\", \"output_limit_exceeded\": 1,\n"
+        " \"verdicts\": {\"AC\": 1, \"OLE\": 1}, \"interaction\": {\"queries\": 9, \"round_trips\": 9},\n"
+        " \"failed_test_details\": [\"Test 2 (b): rerun\", \"Test 3 (c): too long\"],\n"
+        " \"failed_test_diffs\": [{\"test\": 2}],\n"
+        " \"test_results\": [\n"
+        "  {\"test\": 2, \"passed\": true, \"verdict\": \"AC\", \"weight\": 1, \"queries\": 5, \"round_trips\": 5,"
+        " \"mean_latency_ms\": 9.0, \"max_latency_ms\": 9.0},\n"
+        "  {\"test\": 3, \"passed\": false, \"verdict\": \"OLE\", \"weight\": 2, \"output_limit_exceeded\": true,"
+        " \"queries\": 1, \"round_trips\": 1, \"mean_latency_ms\": 2.0, \"max_latency_ms\": 2.0}]}\n";
+    const char *group = "merge";
+    char path_a[MAX_PATH_SIZE], path_b[MAX_PATH_SIZE], merged_path[MAX_PATH_SIZE];
+    if (write_self_check_file(dir, "a.json", partial_a, path_a, sizeof(path_a)) != 0 ||
+        write_self_check_file(dir, "b.json", partial_b, path_b, sizeof(path_b)) != 0 ||
+        snprintf(merged_path, sizeof(merged_path), "%s/merged.json", dir) >= (int)sizeof(merged_path)) {
+        return self_check(0, group, "writing the partials");
+    }
+    char *paths[] = {path_a, path_b};
+    if (merge_partial_results(merged_path, 2, paths) != 0) return self_check(0, group, "merging");
+    json_object *merged = json_object_from_file(merged_path);
+    if (!merged) return self_check(0, group, "reading the merged file");
+
+    json_object *field, *count;
+    int failures = 0;
+    failures += self_check(json_object_object_get_ex(merged, "total_tests", &field) &&
+                           json_object_get_int(field) == 3, group, "overlap counted once in total_tests");
+    failures += self_check(json_object_object_get_ex(merged, "tests_passed", &field) &&
+                           json_object_get_int(field) == 1, group, "the first partial's outcome wins");
+    failures += self_check(json_object_object_get_ex(merged, "weighted_score", &field) &&
+                           fabs(json_object_get_double(field) - 25.0) < 0.05, group, "weighted_score");
+    failures += self_check(json_object_object_get_ex(merged, "verdicts", &field) &&
+                           json_object_object_get_ex(field, "AC", &count) && json_object_get_int(count) == 1 &&
+                           json_object_object_get_ex(field, "WA", &count) && json_object_get_int(count) == 1 &&
+                           json_object_object_get_ex(field, "OLE", &count) && json_object_get_int(count) == 1,
+                           group, "verdicts counted from the kept outcomes");
+    failures += self_check(json_object_object_get_ex(merged, "output_limit_exceeded", &field) &&
+                           json_object_get_int(field) == 1, group, "output_limit_exceeded");
+    failures += self_check(json_object_object_get_ex(merged, "failed_test_details", &field) &&
+                           json_object_array_length(field) == 2, group, "failure details once per test");
+    failures += self_check(json_object_object_get_ex(merged, "failed_test_diffs", &field) &&
+                           json_object_array_length(field) == 1, group, "failure diffs once per test");
+    failures += self_check(json_object_object_get_ex(merged, "interaction", &field) &&
+                           json_object_object_get_ex(field, "round_trips", &count) &&
+                           json_object_get_int(count) == 5 &&
+                           json_object_object_get_ex(field, "queries", &count) && json_object_get_int(count) == 5,
+                           group, "interaction totals over the kept tests");
+    failures += self_check(!json_object_object_get_ex(merged, "early_stop", NULL) &&
+                           !json_object_object_get_ex(merged, "weighted_score_bounds", NULL) &&
+                           !json_object_object_get_ex(merged, "shard", NULL), group, "per-run fields dropped");
+    json_object_put(merged);
+    return failures;
+}
+
+typedef struct {
+    CompareMode mode;
+    double abs_epsilon;
+    double rel_epsilon;
+    const char *expected;
+    const char *actual;
+    long mismatch_offset; // -1 for a match
+    const char *name;
+} ComparatorCheck;
+
+/**
+ * @brief Compares actual against expected, pushing the actual output in chunks of the given size.
+ * @return Mismatch offset, -1 for a match, or -2 if the expected stream cannot be opened.
+ */
+long compare_in_chunks(const ComparatorSpec *spec, const char *expected, const char *actual,
+                       size_t len, size_t chunk) {
+    FILE *expected_stream = open_string_stream(expected);
+    if (!expected_stream) return -2;
+    OutputComparator *cmp = malloc(sizeof(*cmp)); // Holds a 64 KB window, too big for the stack here
+    if (!cmp) {
+        fclose(expected_stream);
+        return -2;
+    }
+    comparator_init(cmp, spec, expected_stream);
+    for (size_t i = 0; i < len; i += chunk) {
+        comparator_feed(cmp, actual + i, (len - i < chunk) ? len - i : chunk);
+    }
+    long offset = comparator_finish(cmp) ? cmp->mismatch_offset : -1;
+    free(cmp);
+    fclose(expected_stream);
+    return offset;
+}
+
+/**
+ * @brief Comparator edge cases for every mode, each fed whole, byte by byte and in 3-byte chunks.
+ * @return Number of failed cases.
+ */
+int self_check_comparators(void) {
+    static const ComparatorCheck cases[] = {
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2\n", "1 2", -1, "missing final newline"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2", "1 2\n\n  \t", -1, "extra trailing whitespace"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "", "\n", -1, "empty expected, blank output"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "", "x", 0, "empty expected, any output"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2", "1  2", 2, "inner spacing"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "a\nb", "a b", 1, "space for newline"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "abc", "abd", 2, "offset of the first byte"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2 3", "1 2", 3, "output ends early"},
+        {COMPARE_EXACT, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2", "1 2 3", 3, "extra output"},
+        {COMPARE_WHITESPACE, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2\n3\n", "1 \t 2\n3", -1, "spacing within a line"},
+        {COMPARE_WHITESPACE, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2\n3", "1\n2\n3", 2, "line break added"},
+        {COMPARE_WHITESPACE, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1\n\n2", "1\n2", 2, "blank line dropped"},
+        {COMPARE_WHITESPACE, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1\n", "1\n\n\n", -1, "trailing line breaks"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2\n3", "\n1\n2 3\n", -1, "free layout"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2", "1 2 3", 4, "extra token"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1 2 3", "1 2", 3, "missing token"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "12", "1 2", 0, "token split in two"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "x abc", "x abcd", 2, "longer token"},
+        {COMPARE_TOKEN, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1.0", "1", 0, "no numeric tolerance"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "0.33333331", "0.3333333", -1, "within abs epsilon"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1000000.5", "1000000", -1, "within rel epsilon"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "5 1.01", "5.0 1", 4, "outside both epsilons"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1000", "1e3", -1, "exponent notation"},
+        {COMPARE_NUMERIC, 0.01, 0, "1.005", "1.0", -1, "custom abs epsilon"},
+        {COMPARE_NUMERIC, 0.01, 0, "100.5", "100", 0, "zero rel epsilon"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "NaN", "nan", 0, "nan is not a number"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1e400", "inf", 0, "infinities rejected"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "ok 1", "OK 1", 0, "words compared exactly"},
+        {COMPARE_NUMERIC, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON, "1.0x", "1x", 0, "trailing garbage"},
+    };
+    static const size_t chunks[] = {SIZE_MAX, 1, 3};
+    const char *group = "comparator";
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const ComparatorCheck *check = &cases[c];
+        ComparatorSpec spec = {check->mode, check->abs_epsilon, check->rel_epsilon};
+        size_t len = strlen(check->actual);
+        int ok = 1;
+        for (size_t k = 0; k < sizeof(chunks) / sizeof(chunks[0]); k++) {
+            size_t chunk = chunks[k] < len ? chunks[k] : len;
+            ok &= compare_in_chunks(&spec, check->expected, check->actual, len, chunk) == check->mismatch_offset;
+        }
+        failures += self_check(ok, group, check->name);
+    }
+
+    // Outputs longer than the comparator's expected window, with and without a late difference
+    size_t size = 3 * COMPARE_BUFFER_SIZE + 17;
+    char *expected = malloc(size + 1), *actual = malloc(size + 1);
+    if (!expected || !actual) {
+        free(expected);
+        free(actual);
+        return failures + self_check(0, group, "allocating the long outputs");
+    }
+    fill_benchmark_output(expected, size, 7);
+    expected[size] = '\0';
+    memcpy(actual, expected, size + 1);
+    long late = (long)size - 5;
+    while (late > 0 && IS_SPACE_BYTE(expected[late])) late--;
+    actual[late] = (expected[late] == '9') ? '8' : '9';
+    for (int mode = COMPARE_EXACT; mode <= COMPARE_NUMERIC; mode++) {
+        ComparatorSpec spec = {(CompareMode)mode, DEFAULT_ABS_EPSILON, DEFAULT_REL_EPSILON};
+        long start = late;
+        if (mode != COMPARE_EXACT) {
+            while (start > 0 && !IS_SPACE_BYTE(expected[start - 1])) start--;
+        }
+        int ok = compare_in_chunks(&spec, expected, expected, size, 4093) == -1 &&
+                 compare_in_chunks(&spec, expected, actual, size, size) == start &&
+                 compare_in_chunks(&spec, expected, actual, size, 4093) == start;
+        failures += self_check(ok, group, "output longer than the expected window");
+    }
+    free(expected);
+    free(actual);
+    return failures;
+}
+
+/**
+ * @brief Makes one diff line per character of text, for spelling diff cases as strings.
+ */
+void diff_lines_from_chars(const char *text, int count, DiffLine *lines) {
+    for (int i = 0; i < count; i++) {
+        lines[i] = (DiffLine){text + i, 1, 1, fnv1a_hash(FNV_OFFSET_BASIS, text + i, 1)};
+    }
+}
+
+/**
+ * @brief Diffs a against b (one line per character).
+ * @return 1 if the ops replay a into b with exactly `edits` insertions and deletions, or if
+ *         edits is -1 and the search gave up.
+ */
+int myers_diff_gives(const char *a, const char *b, int edits) {
+    int n = (int)strlen(a), m = (int)strlen(b);
+    DiffLine *lines_a = malloc((n + 1) * sizeof(DiffLine));
+    DiffLine *lines_b = malloc((m + 1) * sizeof(DiffLine));
+    DiffOp *ops = malloc((n + m + 1) * sizeof(DiffOp));
+    int ok = 0;
+    if (!lines_a || !lines_b || !ops) goto done;
+    diff_lines_from_chars(a, n, lines_a);
+    diff_lines_from_chars(b, m, lines_b);
+
+    int num_ops = myers_diff(lines_a, n, lines_b, m, ops);
+    if (num_ops < 0) {
+        ok = (edits < 0);
+        goto done;
+    }
+
+    // Replay: kept and deleted lines walk a in order, kept and inserted lines walk b in order
+    int x = 0, y = 0, changes = 0;
+    ok = 1;
+    for (int i = 0; i < num_ops && ok; i++) {
+        const DiffOp *op = &ops[i];
+        if (op->op == ' ') {
+            ok = op->a == x && op->b == y && a[x] == b[y];
+            x++;
+            y++;
+        } else if (op->op == '-') {
+            ok = op->a == x++;
+            changes++;
+        } else {
+            ok = op->op == '+' && op->b == y++;
+            changes++;
+        }
+    }
+    ok = ok && x == n && y == m && changes == edits;
+
+done:
+    free(lines_a);
+    free(lines_b);
+    free(ops);
+    return ok;
+}
+
+/**
+ * @brief Myers diff: minimal edit scripts that replay into the new side, and the search limit.
+ * @return Number of failed cases.
+ */
+int self_check_myers_diff(void) {
+    const char *group = "myers diff";
+    int failures = 0;
+    failures += self_check(myers_diff_gives("", "", 0), group, "both empty");
+    failures += self_check(myers_diff_gives("abc", "abc", 0), group, "identical");
+    failures += self_check(myers_diff_gives("", "abc", 3), group, "all inserted");
+    failures += self_check(myers_diff_gives("abc", "", 3), group, "all deleted");
+    failures += self_check(myers_diff_gives("abcabba", "cbabac", 5), group, "minimal script (D = 5)");
+    failures += self_check(myers_diff_gives("abcd", "acbd", 2), group, "swapped lines");
+    failures += self_check(myers_diff_gives("xaaaaaay", "aaaaaa", 2), group, "common run kept");
+
+    // DIFF_MAX_EDITS edits still succeed, one more gives up
+    char *a = malloc(DIFF_MAX_EDITS + 2), *b = malloc(DIFF_MAX_EDITS + 2);
+    if (!a || !b) {
+        free(a);
+        free(b);
+        return failures + self_check(0, group, "allocating the edit-limit case");
+    }
+    memset(a, 'x', DIFF_MAX_EDITS / 2 + 1);
+    memset(b, 'y', DIFF_MAX_EDITS / 2);
+    a[DIFF_MAX_EDITS / 2] = '\0';
+    b[DIFF_MAX_EDITS / 2] = '\0';
+    failures += self_check(myers_diff_gives(a, b, DIFF_MAX_EDITS), group, "exactly DIFF_MAX_EDITS edits");
+    a[DIFF_MAX_EDITS / 2] = 'x';
+    a[DIFF_MAX_EDITS / 2 + 1] = '\0';
+    failures += self_check(myers_diff_gives(a, b, -1), group, "past DIFF_MAX_EDITS edits");
+    free(a);
+    free(b);
+    return failures;
+}
+
+typedef struct {
+    const char *a;
+    const char *b;
+    int same; // Whether batch grading may treat the two sources as one
+    const char *name;
+} NormalizeCheck;
+
+/**
+ * @brief Writes text to dir/name and normalizes it like a batch submission.
+ * @return A malloc'd buffer (see normalize_source), or NULL on failure.
+ */
+char *normalize_self_check_source(const char *dir, const char *name, const char *text, size_t *length) {
+    char path[MAX_PATH_SIZE];
+    if (write_self_check_file(dir, name, text, path, sizeof(path)) != 0) return NULL;
+    return normalize_source(path, length);
+}
+
+/**
+ * @brief Batch grouping: which sources normalize equal, local includes, result file names.
+ * @return Number of failed cases.
+ */
+int self_check_batch_grouping(const char *dir) {
+    static const NormalizeCheck pairs[] = {
+        {"int main() {\n    return 0;\n}\n", "// entry point\nint main() { /* fine */\n\treturn 0;   }", 1,
+         "comments and indentation"},
+        {"int x = 1;\nint y;\n", "int x = 1; int y;", 1, "re-wrapped lines"},
+        {"int a; // note\nint b;", "int a;\nint b;", 1, "line comment up to the newline"},
+        {"char q = '\"'; // x\nint a;", "char q = '\"'; int a;", 1, "quote in a character literal"},
+        {"int/**/x;", "int x;", 1, "block comment as a separator"},
+        {"#define X 1\nint a;", "#define X 1 int a;", 0, "newline ending a directive"},
+        {"int a;\n#include <x.h>\n", "int a; #include <x.h>", 0, "directive only at line start"},
+        {"#define X \\\n  1\nint a;", "#define X \\\n  1 int a;", 0, "directive ends after its continuation"},
+        {"#define X \\\n  1\nint a;", "#define  X \\\n1\n  int a;", 1, "layout inside a continued directive"},
+        {"puts(\"a  b\");", "puts(\"a b\");", 0, "spacing inside a string literal"},
+        {"puts(\"//x\"); int a;", "puts(\"//x\");", 0, "comment marker inside a string literal"},
+        {"x = a+ +b;", "x = a++b;", 0, "space between tokens"},
+    };
+    static const struct {
+        const char *text;
+        int local;
+        const char *name;
+    } includes[] = {
+        {"#include <stdio.h>\nint a;", 0, "system include"},
+        {"  #  include \"util.h\"\n", 1, "indented local include"},
+        {"#import \"x.h\"\n", 1, "local import"},
+        {"#include HEADER\n", 1, "macro include"},
+        {"// #include \"x.h\"\nint a;", 0, "include in a comment"},
+        {"puts(\"#include \\\"x.h\\\"\");", 0, "include in a string literal"},
+    };
+    const char *group = "batch grouping";
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(pairs) / sizeof(pairs[0]); c++) {
+        size_t len_a = 0, len_b = 0;
+        char *a = normalize_self_check_source(dir, "a.c", pairs[c].a, &len_a);
+        char *b = normalize_self_check_source(dir, "b.c", pairs[c].b, &len_b);
+        int same = a && b && len_a == len_b && memcmp(a, b, len_a) == 0;
+        failures += self_check(a && b && same == pairs[c].same, group, pairs[c].name);
+        free(a);
+        free(b);
+    }
+    for (size_t c = 0; c < sizeof(includes) / sizeof(includes[0]); c++) {
+        size_t len = 0;
+        char *normalized = normalize_self_check_source(dir, "inc.c", includes[c].text, &len);
+        failures += self_check(normalized && has_local_include(normalized, len) == includes[c].local,
+                               group, includes[c].name);
+        free(normalized);
+    }
+
+    char path_a[MAX_PATH_SIZE], path_b[MAX_PATH_SIZE], small[8];
+    int ok = batch_result_path("out", "a_b/c.c", path_a, sizeof(path_a)) == 0 &&
+             batch_result_path("out", "a/b_c.c", path_b, sizeof(path_b)) == 0;
+    failures += self_check(ok && strcmp(path_a, "out/a%5Fb_c.c.json") == 0 && strcmp(path_b, "out/a_b%5Fc.c.json") == 0,
+                           group, "result names keep a_b/c.c and a/b_c.c apart");
+    failures += self_check(batch_result_path("out", "main.c", small, sizeof(small)) == -1, group,
+                           "result name too long");
+    return failures;
+}
+
+/**
+ * @brief `self-check`: runs the grading logic (merge, comparators, diffs, batch grouping) on
+ *        fixed cases, so a change in it is caught before it changes anyone's score.
+ * @return 0 if every case holds, -1 otherwise.
+ */
+int run_self_checks(void) {
+    char dir[] = "/tmp/eval_self_check_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp (self-check)");
+        return -1;
+    }
+
+    printf("🧪 Self-check\n");
+    int failures = 0;
+    failures += self_check_merge(dir);
+    failures += self_check_comparators();
+    failures += self_check_myers_diff();
+    failures += self_check_batch_grouping(dir);
+    remove_tree(dir);
+
+    if (failures > 0) {
+        printf("❌ %d self-check case(s) failed\n", failures);
+        return -1;
+    }
+    printf("✅ All self-check cases passed\n");
+    return 0;
+}
@@ -5,6 +5,7 @@ set -e  # Exit on any error
 # Configuration
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 TEMP_DIR="/tmp/code_eval_$$"
+EVALUATOR="${EVALUATOR:-$SCRIPT_DIR/build/eval}"  # Built by `make` (or `make pgo`); EVALUATOR_PREBUILT=1 skips the make check
 TIMESTAMP=$(date +"%Y%m%d_%H%M%S")
 
 # Color codes for output
@@ -138,7 +139,7 @@ main() {
     
     local test_cases_file="$TEMP_DIR/generated_tests.json"
     
-    if python3 "$SCRIPT_DIR/test_generator.py" "$abs_source_file" "$test_cases_file"; then
+    if python3 "$SCRIPT_DIR/testcase.py" "$abs_source_file" "$test_cases_file"; then
         print_success "Test cases generated successfully"
         cp "$test_cases_file" "$abs_output_dir/generated_test_cases.json"
     else
@@ -152,19 +153,20 @@ main() {
     
     local evaluation_results="$TEMP_DIR/eval_results.json"
     
-    # Compile the enhanced evaluator if needed
-    local evaluator_exe="$TEMP_DIR/enhanced_evaluator"
-    if ! gcc -o "$evaluator_exe" "$SCRIPT_DIR/enhanced_safe_eval.c" -ljson-c; then
-        print_error "Failed to compile enhanced evaluator"
+    # Use the prebuilt evaluator; make only rebuilds it when eval.c changed
+    if [ -z "${EVALUATOR_PREBUILT:-}" ] && ! make -s -C "$SCRIPT_DIR" release; then
+        print_error "Failed to build the evaluator"
+        exit 1
+    fi
+    if [ ! -x "$EVALUATOR" ]; then
+        print_error "Evaluator '$EVALUATOR' not found (run make)"
         exit 1
     fi
     
     # Run evaluation
-    if "$evaluator_exe" "$abs_source_file" "$test_cases_file"; then
+    if "$EVALUATOR" --output "$evaluation_results" "$abs_source_file" "$test_cases_file"; then
         print_success "Code evaluation completed"
-        # Copy results from /tmp/eval_results.json to our output directory
-        cp "/tmp/eval_results.json" "$abs_output_dir/evaluation_metrics.json"
-        cp "/tmp/eval_results.json" "$evaluation_results"
+        cp "$evaluation_results" "$abs_output_dir/evaluation_metrics.json"
     else
         print_error "Code evaluation failed"
         exit 1
@@ -174,9 +176,8 @@ main() {
     print_stage "STAGE 3: COMPREHENSIVE CODE ANALYSIS AND FEEDBACK"
     print_info "Using CodeLlama to analyze results and provide feedback..."
     
-    local final_report="$abs_output_dir/comprehensive_report.txt"
-    
-    if python3 "$SCRIPT_DIR/code_analyzer.py" "$abs_source_file" "$evaluation_results" "$final_report"; then
+    # The analyzer writes comprehensive_analysis.json and feedback_report.txt to its working directory
+    if (cd "$abs_output_dir" && python3 "$SCRIPT_DIR/Llm_as_judge.py" "$abs_source_file" "$evaluation_results"); then
         print_success "Comprehensive analysis completed"
     else
         print_error "Failed to complete comprehensive analysis"
@@ -201,9 +202,9 @@ main() {
     fi
     
     # Extract grade from comprehensive analysis
-    if [ -f "$abs_output_dir/comprehensive_report.json" ]; then
-        local grade=$(python3 -c "import json; print(json.load(open('$abs_output_dir/comprehensive_report.json')).get('overall_assessment', {}).get('grade', 'N/A'))")
-        local score=$(python3 -c "import json; print(json.load(open('$abs_output_dir/comprehensive_report.json')).get('overall_assessment', {}).get('score', 0))")
+    if [ -f "$abs_output_dir/comprehensive_analysis.json" ]; then
+        local grade=$(python3 -c "import json; print(json.load(open('$abs_output_dir/comprehensive_analysis.json')).get('final_assessment', {}).get('grade', 'N/A'))")
+        local score=$(python3 -c "import json; print(json.load(open('$abs_output_dir/comprehensive_analysis.json')).get('final_assessment', {}).get('score', 0))")
         
         echo -e "${GREEN}🎓 FINAL ASSESSMENT:${NC}"
         echo -e "   Grade: ${grade}"
@@ -216,8 +217,8 @@ main() {
     echo "Generated files:"
     echo "  📋 generated_test_cases.json    - LLM-generated test cases"
     echo "  📊 evaluation_metrics.json      - Detailed evaluation metrics"
-    echo "  📄 comprehensive_report.txt     - Human-readable analysis report"
-    echo "  📋 comprehensive_report.json    - Detailed analysis data"
+    echo "  📄 feedback_report.txt          - Human-readable analysis report"
+    echo "  📋 comprehensive_analysis.json  - Detailed analysis data"
     echo ""
     print_success "Evaluation pipeline completed successfully!"
 }